@@ -1,16 +1,27 @@
 #include <algorithm>
-#include <deque>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <queue>
-#include <map>
 #include <unordered_set>
 #include <iterator>
 #include <sstream>
 #include <memory>
 #include <stdexcept>
+#include <thread>
+#include <functional>
 #include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 //  std::make_unique will be available since c++14
 //  Implementation was taken from http://herbsutter.com/gotw/_102/
@@ -64,217 +75,326 @@ namespace traverses {
         }
     }
 
+    // Overload for graphs whose vertexes are indices in [0, vertexes_number):
+    // visited vertexes are kept in a bitset and levels in two swapped vectors
+    template<class Visitor, class Graph, class Vertex>
+    void BreadthFirstSearch(Vertex origin_vertex, Visitor visitor,
+            const Graph& graph, size_t vertexes_number) {
+        std::vector<Vertex> current_level;
+        std::vector<Vertex> next_level;
+        std::vector<bool> visited_vertexes(vertexes_number, false);
+
+        visitor.DiscoverVertex(origin_vertex);
+        current_level.push_back(origin_vertex);
+        visited_vertexes[origin_vertex] = true;
+
+        while (!current_level.empty()) {
+            for (Vertex vertex : current_level) {
+                visitor.ExamineVertex(vertex);
+                for (const auto &edge : graph.OutgoingEdges(vertex)) {
+                    visitor.ExamineEdge(edge);
+                    Vertex target = graph.GetTarget(edge);
+                    if (!visited_vertexes[target]) {
+                        visitor.DiscoverVertex(target);
+                        next_level.push_back(target);
+                        visited_vertexes[target] = true;
+                    }
+                }
+            }
+            current_level.swap(next_level);
+            next_level.clear();
+        }
+    }
+
+    // Default hooks for visitors of BreadthFirstSearch; it is a template over
+    // the visitor type, so derived visitors hide the hooks they need and calls
+    // are resolved statically
     template<class Vertex, class Edge>
     class BfsVisitor {
     public:
-        virtual void DiscoverVertex(Vertex /*vertex*/) {}
-        virtual void ExamineEdge(const Edge& /*edge*/) {}
-        virtual void ExamineVertex(Vertex /*vertex*/) {}
-        virtual ~BfsVisitor() {}
+        void DiscoverVertex(Vertex /*vertex*/) {}
+        void ExamineEdge(const Edge& /*edge*/) {}
+        void ExamineVertex(Vertex /*vertex*/) {}
+
+    protected:
+        ~BfsVisitor() {}
     };
 
 } // namespace traverses
 
 namespace aho_corasick {
 
+    const uint32_t kNoState = UINT32_MAX;
+    const uint32_t kRoot = 0;
+    // Flattened outputs are not stored if they would take more entries
+    // than this many per state and string
+    const size_t kMaxFlattenedOutputsFactor = 4;
+
+    // Node of the trie which is used while the automaton is being built
     struct AutomatonNode {
-        AutomatonNode():
-            suffix_link(nullptr),
-            terminal_link(nullptr) {
-        }
-
-        std::vector<size_t> matched_string_ids;
-        // Stores tree structure of nodes
-        std::map<char, AutomatonNode> trie_transitions;
-        // Stores pointers to the elements of trie_transitions
-        std::map<char, AutomatonNode*> automaton_transitions;
-        AutomatonNode* suffix_link;
-        AutomatonNode* terminal_link;
+        explicit AutomatonNode(char character):
+            first_child(0),
+            children_number(0),
+            suffix_link(kNoState),
+            terminal_link(kNoState),
+            character(character) {
+        }
+
+        // Children occupy a contiguous range of nodes sorted by character
+        uint32_t first_child;
+        uint32_t children_number;
+        uint32_t suffix_link;
+        uint32_t terminal_link;
+        // Character on the edge from the parent
+        char character;
     };
 
-    // Returns nullptr if there is no such transition
-    AutomatonNode* GetTrieTransition(AutomatonNode* node, char character) {
-        auto character_and_node = node->trie_transitions.find(character);
-        if (character_and_node == node->trie_transitions.end()) {
-            return nullptr;
+    // Nodes are stored in breadth-first order in one array,
+    // matched string ids of all nodes are stored in one pool
+    struct Trie {
+        bool HasMatchedStrings(uint32_t node) const {
+            return matched_string_offsets[node] != matched_string_offsets[node + 1];
         }
-        return &character_and_node->second;
+
+        std::vector<AutomatonNode> nodes;
+        // Ids of strings ending at node are
+        // matched_string_ids[matched_string_offsets[node]..matched_string_offsets[node + 1])
+        std::vector<uint64_t> matched_string_offsets;
+        std::vector<uint64_t> matched_string_ids;
+    };
+
+    bool CharacterLess(char first, char second) {
+        return static_cast<unsigned char>(first) < static_cast<unsigned char>(second);
     }
 
-    // Performs transition in automaton
-    AutomatonNode* GetNextNode(AutomatonNode* node, AutomatonNode* root,
-            char character) {
-        {
-            auto character_and_node
-                = node->automaton_transitions.find(character);
-            if (character_and_node != node->automaton_transitions.end()) {
-                return character_and_node->second;
-            }
+    // Returns kNoState if there is no such transition
+    uint32_t GetTrieTransition(const Trie& trie, uint32_t node, char character) {
+        auto begin = trie.nodes.begin() + trie.nodes[node].first_child;
+        auto end = begin + trie.nodes[node].children_number;
+        auto child = std::lower_bound(begin, end, character,
+            [](const AutomatonNode& child, char character) {
+                return CharacterLess(child.character, character);
+            });
+        if (child == end || child->character != character) {
+            return kNoState;
         }
-        AutomatonNode* character_and_node = GetTrieTransition(node, character);
-        if (character_and_node != nullptr) {
-            node->automaton_transitions[character]
-                = character_and_node;
-            return character_and_node;
+        return static_cast<uint32_t>(child - trie.nodes.begin());
+    }
+
+    // Performs transition in automaton using suffix links
+    // which are already calculated
+    uint32_t GetNextNode(const Trie& trie, uint32_t node, char character) {
+        uint32_t child = GetTrieTransition(trie, node, character);
+        if (child != kNoState) {
+            return child;
         }
-        if (node == root) {
+        if (node == kRoot) {
             return node;
         }
-        return GetNextNode(node->suffix_link, root, character);
+        return GetNextNode(trie, trie.nodes[node].suffix_link, character);
     }
 
-    class AutomatonGraph;
-
     class AutomatonGraph {
     public:
         struct Edge {
-            Edge(AutomatonNode* source,
-                    AutomatonNode* target,
+            Edge(uint32_t source,
+                    uint32_t target,
                     char character):
                 source(source),
                 target(target),
                 character(character) {
             }
 
-            AutomatonNode* source;
-            AutomatonNode* target;
+            uint32_t source;
+            uint32_t target;
             char character;
         };
 
-        // Returns edges corresponding to all trie transitions from vertex
-        std::vector<Edge> OutgoingEdges(AutomatonNode* vertex) const {
-            std::vector<Edge> outgoing_edges;
-            for (auto &character_and_node : vertex->trie_transitions) {
-                outgoing_edges.emplace_back(vertex, &character_and_node.second,
-                    character_and_node.first);
+        // Makes edges to the children of a node on the fly
+        class EdgeIterator {
+        public:
+            EdgeIterator(const Trie* trie, uint32_t source, uint32_t child):
+                trie_(trie), source_(source), child_(child) {}
+
+            Edge operator*() const {
+                return Edge(source_, child_, trie_->nodes[child_].character);
             }
-            return outgoing_edges;
+
+            EdgeIterator& operator++() {
+                ++child_;
+                return *this;
+            }
+
+            bool operator!=(const EdgeIterator& other) const {
+                return child_ != other.child_;
+            }
+
+        private:
+            const Trie* trie_;
+            uint32_t source_;
+            uint32_t child_;
+        };
+
+        explicit AutomatonGraph(const Trie* trie):
+            trie_(trie) {}
+
+        // Returns edges corresponding to all trie transitions from vertex
+        IteratorRange<EdgeIterator> OutgoingEdges(uint32_t vertex) const {
+            const AutomatonNode& node = trie_->nodes[vertex];
+            return IteratorRange<EdgeIterator>(
+                EdgeIterator(trie_, vertex, node.first_child),
+                EdgeIterator(trie_, vertex, node.first_child + node.children_number));
         }
 
-        AutomatonNode* GetTarget(const Edge& edge) const {
+        uint32_t GetTarget(const Edge& edge) const {
             return edge.target;
         }
+
+        size_t VertexesNumber() const {
+            return trie_->nodes.size();
+        }
+
+    private:
+        const Trie* trie_;
     };
 
     class SuffixLinkCalculator:
-        public traverses::BfsVisitor<AutomatonNode*, AutomatonGraph::Edge> {
+        public traverses::BfsVisitor<uint32_t, AutomatonGraph::Edge> {
     public:
-        explicit SuffixLinkCalculator(AutomatonNode* root):
-            root_(root) {}
+        explicit SuffixLinkCalculator(Trie* trie):
+            trie_(trie) {}
 
-        void ExamineVertex(AutomatonNode* node) {
-            if (node == root_) {
-                node->suffix_link = root_;
+        void ExamineVertex(uint32_t node) {
+            if (node == kRoot) {
+                trie_->nodes[node].suffix_link = kRoot;
             }
         }
 
         void ExamineEdge(const AutomatonGraph::Edge& edge) {
-            if (edge.source == root_) {
-                edge.target->suffix_link = root_;
+            if (edge.source == kRoot) {
+                trie_->nodes[edge.target].suffix_link = kRoot;
             } else {
-                edge.target->suffix_link = GetNextNode(edge.source->suffix_link,
-                    root_, edge.character);
+                trie_->nodes[edge.target].suffix_link = GetNextNode(*trie_,
+                    trie_->nodes[edge.source].suffix_link, edge.character);
             }
         }
 
     private:
-        AutomatonNode* root_;
+        Trie* trie_;
     };
 
     class TerminalLinkCalculator:
-        public traverses::BfsVisitor<AutomatonNode*, AutomatonGraph::Edge> {
+        public traverses::BfsVisitor<uint32_t, AutomatonGraph::Edge> {
     public:
-        explicit TerminalLinkCalculator(AutomatonNode* root):
-            root_(root) {}
+        explicit TerminalLinkCalculator(Trie* trie):
+            trie_(trie) {}
 
-        void DiscoverVertex(AutomatonNode* node) {
-            if (node == root_) {
-                node->terminal_link = nullptr;
+        void DiscoverVertex(uint32_t node) {
+            if (node == kRoot) {
+                trie_->nodes[node].terminal_link = kNoState;
             } else {
-                if (!node->suffix_link->matched_string_ids.empty()) {
-                    node->terminal_link = node->suffix_link;
+                uint32_t suffix_link = trie_->nodes[node].suffix_link;
+                if (trie_->HasMatchedStrings(suffix_link)) {
+                    trie_->nodes[node].terminal_link = suffix_link;
                 } else {
-                    node->terminal_link = node->suffix_link->terminal_link;
+                    trie_->nodes[node].terminal_link = trie_->nodes[suffix_link].terminal_link;
                 }
             }
         }
 
     private:
-        AutomatonNode* root_;
+        Trie* trie_;
     };
 
+    class Automaton;
+
     class NodeReference {
     public:
-        typedef std::vector<size_t>::const_iterator MatchedStringIterator;
+        typedef const uint64_t* MatchedStringIterator;
         typedef IteratorRange<MatchedStringIterator> MatchedStringIteratorRange;
 
         NodeReference():
-            node_(nullptr),
-            root_(nullptr) {
+            automaton_(nullptr),
+            state_(0) {
         }
-        NodeReference(AutomatonNode* node, AutomatonNode* root):
-            node_(node), root_(root) {
+        NodeReference(const Automaton* automaton, uint32_t state):
+            automaton_(automaton), state_(state) {
         }
 
-        NodeReference Next(char character) const {
-            if (node_ == nullptr) {
-                return NodeReference();
-            }
-            return NodeReference(GetNextNode(node_, root_, character), root_);
-        }
+        NodeReference Next(char character) const;
 
-        NodeReference suffixLink() const {
-            if (node_ == nullptr) {
-                return NodeReference();
-            }
-            return NodeReference(node_->suffix_link, root_);
-        }
+        NodeReference suffixLink() const;
 
-        NodeReference terminalLink() const {
-            if (node_ == nullptr) {
-                return NodeReference();
-            }
-            return NodeReference(node_->terminal_link, root_);
-        }
+        NodeReference terminalLink() const;
 
-        MatchedStringIteratorRange matchedStringIds() const {
-            return MatchedStringIteratorRange(node_->matched_string_ids.begin(),
-                node_->matched_string_ids.end());
-        }
+        MatchedStringIteratorRange matchedStringIds() const;
 
         explicit operator bool() const {
-            return node_ != nullptr;
+            return automaton_ != nullptr;
         }
 
         bool operator==(const NodeReference& other) const {
-            return node_ == other.node_;
+            return automaton_ == other.automaton_ && state_ == other.state_;
         }
 
         bool operator!=(const NodeReference& other) const {
-            return node_ != other.node_;
+            return !(*this == other);
         }
 
     private:
-        AutomatonNode* node_;    
-        AutomatonNode* root_;
+        const Automaton* automaton_;
+        uint32_t state_;
+
+        friend class Automaton;
     };
 
     using std::rel_ops::operator !=;
 
     class AutomatonBuilder;
 
+    // Fully materialized DFA: transitions of all states are stored in one flat
+    // table of StatesNumber() rows over the alphabet of characters met in
+    // the added strings plus one class for all other characters.
+    // The tables are either owned by the automaton or mapped from a file
+    // written by Save, so that many processes share one copy.
     class Automaton {
     public:
-        Automaton() = default;
+        Automaton():
+            byte_classes_(kBytesNumber, 0),
+            alphabet_size_(1),
+            states_number_(0),
+            mapped_data_(nullptr),
+            mapped_size_(0) {
+            UpdateTables();
+        }
 
-        NodeReference Root() {
-            return NodeReference(&root_, &root_);
+        ~Automaton() {
+            if (mapped_data_ != nullptr) {
+                munmap(mapped_data_, mapped_size_);
+            }
+        }
+
+        NodeReference Root() const {
+            return NodeReference(this, 0);
+        }
+
+        size_t StatesNumber() const {
+            return states_number_;
         }
 
         // Calls on_match(string_id) for every string ending at this node,
         // i.e. collects all string ids reachable by terminal links.
         template <class Callback>
-        void GenerateMatches(NodeReference node, Callback on_match) {
+        void GenerateMatches(NodeReference node, Callback on_match) const {
+            if (node && HasFlattenedOutputs()) {
+                for (size_t matched_string_id : Outputs(node)) {
+                    on_match(matched_string_id);
+                }
+                for (size_t matched_string_id : Root().matchedStringIds()) {
+                    on_match(matched_string_id);
+                }
+                return;
+            }
             while (node) {
                 for (size_t matched_string_id : node.matchedStringIds()) {
                     on_match(matched_string_id);
@@ -283,15 +403,293 @@ namespace aho_corasick {
             }
         }
 
+        // Returns number of strings ending at this node without walking
+        // terminal links
+        size_t CountMatches(NodeReference node) const {
+            if (!node) {
+                return 0;
+            }
+            return tables_.match_counts[node.state_];
+        }
+
+        bool HasFlattenedOutputs() const {
+            return tables_.output_offsets != nullptr;
+        }
+
+        // Returns ids of all non-empty strings ending at this node in the order
+        // of GenerateMatches, available if the automaton was built with flattened
+        // outputs; empty strings end at every node and are listed only by
+        // Root().matchedStringIds(), so they don't take memory for every state
+        NodeReference::MatchedStringIteratorRange Outputs(NodeReference node) const {
+            return NodeReference::MatchedStringIteratorRange(
+                tables_.output_ids + tables_.output_offsets[node.state_],
+                tables_.output_ids + tables_.output_offsets[node.state_ + 1]);
+        }
+
+        // Writes the automaton in the native byte order to a file
+        // which can be mapped by Load
+        void Save(const std::string& path) const {
+            FileHeader header = MakeHeader();
+            std::vector<std::pair<const void*, size_t>> sections = Sections(header);
+            header.checksum = Checksum(sections);
+            std::ofstream output_stream(path, std::ios::binary | std::ios::trunc);
+            output_stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            const char padding[kAlignment] = {};
+            for (const auto& section : sections) {
+                output_stream.write(static_cast<const char*>(section.first), section.second);
+                output_stream.write(padding, Padding(section.second));
+            }
+            if (!output_stream) {
+                throw std::runtime_error("Can't write automaton to " + path);
+            }
+        }
+
+        // Maps a file written by Save read-only; throws std::runtime_error
+        // if the file has another format version, byte order or a wrong checksum
+        static std::unique_ptr<Automaton> Load(const std::string& path) {
+            int file_descriptor = open(path.c_str(), O_RDONLY);
+            if (file_descriptor < 0) {
+                throw std::runtime_error("Can't open automaton file " + path);
+            }
+            struct stat file_status;
+            if (fstat(file_descriptor, &file_status) != 0
+                    || static_cast<size_t>(file_status.st_size) < sizeof(FileHeader)) {
+                close(file_descriptor);
+                throw std::runtime_error("Automaton file " + path + " is too short");
+            }
+            size_t file_size = static_cast<size_t>(file_status.st_size);
+            void* data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+            close(file_descriptor);
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("Can't map automaton file " + path);
+            }
+            auto automaton = make_unique<Automaton>();
+            automaton->mapped_data_ = data;
+            automaton->mapped_size_ = file_size;
+            automaton->MapTables(path);
+            return automaton;
+        }
+
     private:
-        AutomatonNode root_;
+        static const size_t kBytesNumber = 256;
+        static const size_t kAlignment = 8;
+        static const uint32_t kFormatVersion = 2;
+        static const uint32_t kByteOrderMark = 0x01020304;
+
+        // Arrays used while scanning, views of the vectors below
+        // or of the mapped file
+        struct Tables {
+            const uint32_t* byte_classes;
+            const uint32_t* transitions;
+            const uint32_t* suffix_links;
+            const uint32_t* terminal_links;
+            const uint64_t* matched_string_offsets;
+            const uint64_t* matched_string_ids;
+            const uint64_t* match_counts;
+            // nullptr unless the automaton has flattened outputs
+            const uint64_t* output_offsets;
+            const uint64_t* output_ids;
+        };
+
+        // Is followed by the arrays of Tables in the same order,
+        // every array is padded to kAlignment bytes
+        struct FileHeader {
+            char magic[8];
+            uint32_t format_version;
+            uint32_t byte_order_mark;
+            uint64_t alphabet_size;
+            uint64_t states_number;
+            uint64_t matched_string_ids_number;
+            uint64_t has_flattened_outputs;
+            uint64_t output_ids_number;
+            // FNV-1a over 8-byte words of everything after the header
+            uint64_t checksum;
+        };
+
+        static size_t Padding(size_t size) {
+            return (kAlignment - size % kAlignment) % kAlignment;
+        }
+
+        static uint64_t Checksum(const std::vector<std::pair<const void*, size_t>>& sections) {
+            uint64_t checksum = 14695981039346656037ULL;
+            for (const auto& section : sections) {
+                const char* bytes = static_cast<const char*>(section.first);
+                for (size_t i = 0; i < section.second; i += kAlignment) {
+                    uint64_t word = 0;
+                    std::memcpy(&word, bytes + i, std::min(kAlignment, section.second - i));
+                    checksum ^= word;
+                    checksum *= 1099511628211ULL;
+                }
+            }
+            return checksum;
+        }
+
+        FileHeader MakeHeader() const {
+            FileHeader header;
+            std::memcpy(header.magic, "AHOCORAS", sizeof(header.magic));
+            header.format_version = kFormatVersion;
+            header.byte_order_mark = kByteOrderMark;
+            header.alphabet_size = alphabet_size_;
+            header.states_number = states_number_;
+            header.matched_string_ids_number = tables_.matched_string_offsets[states_number_];
+            header.has_flattened_outputs = HasFlattenedOutputs() ? 1 : 0;
+            header.output_ids_number = HasFlattenedOutputs()
+                ? tables_.output_offsets[states_number_] : 0;
+            header.checksum = 0;
+            return header;
+        }
+
+        // Returns (array, size in bytes) for every array of tables_
+        std::vector<std::pair<const void*, size_t>> Sections(const FileHeader& header) const {
+            size_t states_number = header.states_number;
+            std::vector<std::pair<const void*, size_t>> sections;
+            sections.emplace_back(tables_.byte_classes, kBytesNumber * sizeof(uint32_t));
+            sections.emplace_back(tables_.transitions,
+                states_number * header.alphabet_size * sizeof(uint32_t));
+            sections.emplace_back(tables_.suffix_links, states_number * sizeof(uint32_t));
+            sections.emplace_back(tables_.terminal_links, states_number * sizeof(uint32_t));
+            sections.emplace_back(tables_.matched_string_offsets,
+                (states_number + 1) * sizeof(uint64_t));
+            sections.emplace_back(tables_.matched_string_ids,
+                header.matched_string_ids_number * sizeof(uint64_t));
+            sections.emplace_back(tables_.match_counts, states_number * sizeof(uint64_t));
+            if (header.has_flattened_outputs) {
+                sections.emplace_back(tables_.output_offsets,
+                    (states_number + 1) * sizeof(uint64_t));
+                sections.emplace_back(tables_.output_ids,
+                    header.output_ids_number * sizeof(uint64_t));
+            }
+            return sections;
+        }
+
+        // Points tables_ to the owned vectors
+        void UpdateTables() {
+            states_number_ = suffix_links_.size();
+            tables_.byte_classes = byte_classes_.data();
+            tables_.transitions = transitions_.data();
+            tables_.suffix_links = suffix_links_.data();
+            tables_.terminal_links = terminal_links_.data();
+            tables_.matched_string_offsets = matched_string_offsets_.data();
+            tables_.matched_string_ids = matched_string_ids_.data();
+            tables_.match_counts = match_counts_.data();
+            tables_.output_offsets = output_offsets_.empty() ? nullptr : output_offsets_.data();
+            tables_.output_ids = output_ids_.data();
+        }
+
+        // Points tables_ to the arrays of the mapped file after validation
+        void MapTables(const std::string& path) {
+            const char* data = static_cast<const char*>(mapped_data_);
+            FileHeader header;
+            std::memcpy(&header, data, sizeof(header));
+            if (std::memcmp(header.magic, "AHOCORAS", sizeof(header.magic)) != 0
+                    || header.format_version != kFormatVersion
+                    || header.byte_order_mark != kByteOrderMark) {
+                throw std::runtime_error(path + " is not a compiled automaton of version "
+                    + std::to_string(kFormatVersion) + " in this byte order");
+            }
+            size_t max_elements_number = mapped_size_ / sizeof(uint32_t);
+            if (header.alphabet_size == 0 || header.alphabet_size > kBytesNumber + 1
+                    || header.states_number == 0 || header.states_number > kNoState
+                    || header.matched_string_ids_number > max_elements_number
+                    || header.output_ids_number > max_elements_number) {
+                throw std::runtime_error("Automaton file " + path + " has a corrupted header");
+            }
+            // Sections holds offsets in the file until they are checked
+            tables_ = Tables();
+            std::vector<std::pair<const void*, size_t>> sections = Sections(header);
+            size_t offset = sizeof(header);
+            for (auto& section : sections) {
+                section.first = data + offset;
+                offset += section.second + Padding(section.second);
+            }
+            if (offset != mapped_size_) {
+                throw std::runtime_error("Automaton file " + path + " has a wrong size");
+            }
+            if (Checksum(sections) != header.checksum) {
+                throw std::runtime_error("Automaton file " + path + " has a wrong checksum");
+            }
+            alphabet_size_ = header.alphabet_size;
+            states_number_ = header.states_number;
+            tables_.byte_classes = static_cast<const uint32_t*>(sections[0].first);
+            tables_.transitions = static_cast<const uint32_t*>(sections[1].first);
+            tables_.suffix_links = static_cast<const uint32_t*>(sections[2].first);
+            tables_.terminal_links = static_cast<const uint32_t*>(sections[3].first);
+            tables_.matched_string_offsets = static_cast<const uint64_t*>(sections[4].first);
+            tables_.matched_string_ids = static_cast<const uint64_t*>(sections[5].first);
+            tables_.match_counts = static_cast<const uint64_t*>(sections[6].first);
+            tables_.output_offsets = nullptr;
+            tables_.output_ids = nullptr;
+            if (header.has_flattened_outputs) {
+                tables_.output_offsets = static_cast<const uint64_t*>(sections[7].first);
+                tables_.output_ids = static_cast<const uint64_t*>(sections[8].first);
+            }
+        }
+
+        uint32_t Transition(uint32_t state, char character) const {
+            return tables_.transitions[state * alphabet_size_
+                + tables_.byte_classes[static_cast<unsigned char>(character)]];
+        }
+
+        std::vector<uint32_t> byte_classes_;
+        size_t alphabet_size_;
+        std::vector<uint32_t> transitions_;
+        std::vector<uint32_t> suffix_links_;
+        std::vector<uint32_t> terminal_links_;
+        // Ids of strings ending at state are
+        // matched_string_ids_[matched_string_offsets_[state]..matched_string_offsets_[state + 1])
+        std::vector<uint64_t> matched_string_offsets_;
+        std::vector<uint64_t> matched_string_ids_;
+        // Number of strings ending at state including ones reachable by terminal links
+        std::vector<uint64_t> match_counts_;
+        // The same strings listed for every state, empty unless requested at build
+        std::vector<uint64_t> output_offsets_;
+        std::vector<uint64_t> output_ids_;
+
+        size_t states_number_;
+        Tables tables_;
+        void* mapped_data_;
+        size_t mapped_size_;
 
         Automaton(const Automaton&) = delete;
         Automaton& operator=(const Automaton&) = delete;
 
         friend class AutomatonBuilder;
+        friend class NodeReference;
     };
 
+    const size_t Automaton::kBytesNumber;
+    const size_t Automaton::kAlignment;
+    const uint32_t Automaton::kFormatVersion;
+    const uint32_t Automaton::kByteOrderMark;
+
+    inline NodeReference NodeReference::Next(char character) const {
+        if (automaton_ == nullptr) {
+            return NodeReference();
+        }
+        return NodeReference(automaton_, automaton_->Transition(state_, character));
+    }
+
+    inline NodeReference NodeReference::suffixLink() const {
+        if (automaton_ == nullptr) {
+            return NodeReference();
+        }
+        return NodeReference(automaton_, automaton_->tables_.suffix_links[state_]);
+    }
+
+    inline NodeReference NodeReference::terminalLink() const {
+        if (automaton_ == nullptr || automaton_->tables_.terminal_links[state_] == kNoState) {
+            return NodeReference();
+        }
+        return NodeReference(automaton_, automaton_->tables_.terminal_links[state_]);
+    }
+
+    inline NodeReference::MatchedStringIteratorRange NodeReference::matchedStringIds() const {
+        const Automaton::Tables& tables = automaton_->tables_;
+        return MatchedStringIteratorRange(
+            tables.matched_string_ids + tables.matched_string_offsets[state_],
+            tables.matched_string_ids + tables.matched_string_offsets[state_ + 1]);
+    }
+
     class AutomatonBuilder {
     public:
         void Add(const std::string& string, size_t id) {
@@ -299,42 +697,189 @@ namespace aho_corasick {
             ids_.push_back(id);
         }
 
-        std::unique_ptr<Automaton> Build() {
+        // flatten_outputs stores for every state the list of all strings
+        // ending there, so GenerateMatches does not walk terminal links;
+        // it takes memory proportional to the total number of such pairs,
+        // not counting empty strings, which are kept only at the root.
+        // Long terminal chains make the lists grow quadratically, so they
+        // are dropped if they exceed kMaxFlattenedOutputsFactor times
+        // the number of states and strings
+        std::unique_ptr<Automaton> Build(bool flatten_outputs = false) {
+            Trie trie;
+            BuildTrie(words_, ids_, &trie);
+            BuildSuffixLinks(&trie);
+            BuildTerminalLinks(&trie);
             auto automaton = make_unique<Automaton>();
-            BuildTrie(words_, ids_, automaton.get());
-            BuildSuffixLinks(automaton.get());
-            BuildTerminalLinks(automaton.get());
+            BuildTransitionTable(&trie, automaton.get());
+            BuildOutputs(automaton.get(), flatten_outputs);
+            automaton->UpdateTables();
             return automaton;
         }
 
     private:
+        // Builds trie level by level from the sorted strings: every node
+        // corresponds to the range of sorted strings starting with its prefix,
+        // so nodes are created in breadth-first order and children of a node
+        // are created together in ascending order of characters
         static void BuildTrie(const std::vector<std::string>& words,
                 const std::vector<size_t>& ids,
-                Automaton* automaton) {
-            for (size_t i = 0; i < words.size(); ++i) {
-                AddString(&automaton->root_, ids[i], words[i]);
+                Trie* trie) {
+            std::vector<size_t> order(words.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = i;
+            }
+            std::stable_sort(order.begin(), order.end(),
+                [&words](size_t first, size_t second) {
+                    return words[first] < words[second];
+                });
+
+            struct StringsRange {
+                size_t begin;
+                size_t end;
+                size_t depth;
+            };
+            std::vector<StringsRange> ranges(1, StringsRange{0, order.size(), 0});
+            trie->nodes.assign(1, AutomatonNode('\0'));
+            trie->matched_string_offsets.assign(1, 0);
+            trie->matched_string_ids.clear();
+            for (size_t node = 0; node < trie->nodes.size(); ++node) {
+                StringsRange range = ranges[node];
+                while (range.begin < range.end && words[order[range.begin]].size() == range.depth) {
+                    trie->matched_string_ids.push_back(ids[order[range.begin]]);
+                    ++range.begin;
+                }
+                trie->matched_string_offsets.push_back(trie->matched_string_ids.size());
+                size_t first_child = trie->nodes.size();
+                while (range.begin < range.end) {
+                    char character = words[order[range.begin]][range.depth];
+                    size_t child_end = range.begin;
+                    while (child_end < range.end
+                            && words[order[child_end]][range.depth] == character) {
+                        ++child_end;
+                    }
+                    trie->nodes.emplace_back(character);
+                    ranges.push_back(StringsRange{range.begin, child_end, range.depth + 1});
+                    range.begin = child_end;
+                }
+                trie->nodes[node].first_child = static_cast<uint32_t>(first_child);
+                trie->nodes[node].children_number
+                    = static_cast<uint32_t>(trie->nodes.size() - first_child);
             }
         }
 
-        static void AddString(AutomatonNode* root, size_t string_id,
-                const std::string& string) {
-            AutomatonNode* node = root;
-            for (char character : string) {
-                node = &node->trie_transitions[character];
+        static void BuildSuffixLinks(Trie* trie) {
+            SuffixLinkCalculator suffix_link_calculator(trie);
+            AutomatonGraph graph(trie);
+            traverses::BreadthFirstSearch(kRoot,
+                suffix_link_calculator, graph, graph.VertexesNumber());
+        }
+
+        static void BuildTerminalLinks(Trie* trie) {
+            TerminalLinkCalculator terminal_link_calculator(trie);
+            AutomatonGraph graph(trie);
+            traverses::BreadthFirstSearch(kRoot,
+                terminal_link_calculator, graph, graph.VertexesNumber());
+        }
+
+        // Splits bytes into classes of bytes leading to the same state from
+        // every state. A byte labelling some trie edge differs from any other
+        // byte at the source of this edge, so it forms its own class, and all
+        // bytes absent in the trie form class 0 leading along suffix links
+        // to the root. Multi-byte UTF-8 characters of the strings thus add
+        // only the bytes they consist of.
+        static void BuildByteClasses(const Trie& trie, Automaton* automaton) {
+            std::fill(automaton->byte_classes_.begin(), automaton->byte_classes_.end(), 0);
+            size_t alphabet_size = 1;
+            for (uint32_t node = 1; node < trie.nodes.size(); ++node) {
+                uint32_t& byte_class = automaton->byte_classes_[
+                    static_cast<unsigned char>(trie.nodes[node].character)];
+                if (byte_class == 0) {
+                    byte_class = static_cast<uint32_t>(alphabet_size++);
+                }
             }
-            node->matched_string_ids.push_back(string_id);
+            automaton->alphabet_size_ = alphabet_size;
         }
 
-        static void BuildSuffixLinks(Automaton* automaton) {
-            SuffixLinkCalculator suffix_link_calculator(&automaton->root_);
-            traverses::BreadthFirstSearch(&automaton->root_,
-                suffix_link_calculator, AutomatonGraph());
+        // Nodes are numbered in breadth-first order, so the suffix link
+        // of a state always has a smaller index and its row is ready
+        static void BuildTransitionTable(Trie* trie, Automaton* automaton) {
+            const std::vector<AutomatonNode>& nodes = trie->nodes;
+            BuildByteClasses(*trie, automaton);
+            size_t alphabet_size = automaton->alphabet_size_;
+            automaton->transitions_.resize(nodes.size() * alphabet_size);
+            automaton->suffix_links_.resize(nodes.size());
+            automaton->terminal_links_.resize(nodes.size());
+
+            for (uint32_t state = 0; state < nodes.size(); ++state) {
+                const AutomatonNode& node = nodes[state];
+                automaton->suffix_links_[state] = node.suffix_link;
+                automaton->terminal_links_[state] = node.terminal_link;
+
+                uint32_t* row = &automaton->transitions_[state * alphabet_size];
+                if (state == kRoot) {
+                    std::fill(row, row + alphabet_size, kRoot);
+                } else {
+                    const uint32_t* suffix_row
+                        = &automaton->transitions_[node.suffix_link * alphabet_size];
+                    std::copy(suffix_row, suffix_row + alphabet_size, row);
+                }
+                for (uint32_t child = node.first_child;
+                        child < node.first_child + node.children_number; ++child) {
+                    row[automaton->byte_classes_[
+                        static_cast<unsigned char>(nodes[child].character)]] = child;
+                }
+            }
+            automaton->matched_string_offsets_.swap(trie->matched_string_offsets);
+            automaton->matched_string_ids_.swap(trie->matched_string_ids);
         }
 
-        static void BuildTerminalLinks(Automaton* automaton) {
-            TerminalLinkCalculator terminal_link_calculator(&automaton->root_);
-            traverses::BreadthFirstSearch(&automaton->root_,
-                terminal_link_calculator, AutomatonGraph());
+        // The terminal link of a state has a smaller index, so its
+        // outputs are ready when the state is processed
+        static void BuildOutputs(Automaton* automaton, bool flatten_outputs) {
+            size_t states_number = automaton->suffix_links_.size();
+            const std::vector<uint64_t>& offsets = automaton->matched_string_offsets_;
+            const std::vector<uint64_t>& ids = automaton->matched_string_ids_;
+            automaton->match_counts_.resize(states_number);
+            for (uint32_t state = 0; state < states_number; ++state) {
+                uint32_t terminal_link = automaton->terminal_links_[state];
+                automaton->match_counts_[state] = offsets[state + 1] - offsets[state];
+                if (terminal_link != kNoState) {
+                    automaton->match_counts_[state] += automaton->match_counts_[terminal_link];
+                }
+            }
+
+            automaton->output_offsets_.clear();
+            automaton->output_ids_.clear();
+            // strings ending at the root end at every state
+            // and are not stored in the lists
+            uint64_t root_matches_number = automaton->match_counts_[kRoot];
+            uint64_t outputs_number = 0;
+            for (uint64_t match_count : automaton->match_counts_) {
+                outputs_number += match_count - root_matches_number;
+            }
+            if (!flatten_outputs || outputs_number
+                    > kMaxFlattenedOutputsFactor * (states_number + ids.size())) {
+                return;
+            }
+            automaton->output_offsets_.reserve(states_number + 1);
+            automaton->output_offsets_.push_back(0);
+            automaton->output_ids_.reserve(outputs_number);
+            for (uint32_t state = 0; state < states_number; ++state) {
+                uint32_t terminal_link = automaton->terminal_links_[state];
+                std::vector<uint64_t>& output_ids = automaton->output_ids_;
+                if (state != kRoot) {
+                    output_ids.insert(output_ids.end(),
+                        ids.begin() + offsets[state], ids.begin() + offsets[state + 1]);
+                }
+                if (terminal_link != kNoState) {
+                    size_t begin = automaton->output_offsets_[terminal_link];
+                    size_t end = automaton->output_offsets_[terminal_link + 1];
+                    for (size_t i = begin; i < end; ++i) {
+                        output_ids.push_back(output_ids[i]);
+                    }
+                }
+                automaton->output_offsets_.push_back(output_ids.size());
+            }
         }
 
         std::vector<std::string> words_;
@@ -360,82 +905,576 @@ std::vector<std::string> Split(const std::string& string,
     return substrings;
 }
 
+// In UTF8 encoding a character is a code point taking from 1 to 4 bytes
+enum class Encoding {
+    BYTES,
+    UTF8
+};
+
+// Returns number of continuation bytes following the given first byte
+// of a UTF-8 code point; malformed bytes are deemed one-byte characters
+size_t Utf8ContinuationBytesNumber(unsigned char first_byte) {
+    if ((first_byte & 0xE0) == 0xC0) {
+        return 1;
+    }
+    if ((first_byte & 0xF0) == 0xE0) {
+        return 2;
+    }
+    if ((first_byte & 0xF8) == 0xF0) {
+        return 3;
+    }
+    return 0;
+}
+
+size_t CharactersNumber(const std::string& string, Encoding encoding) {
+    if (encoding == Encoding::BYTES) {
+        return string.size();
+    }
+    size_t characters_number = 0;
+    for (size_t i = 0; i < string.size(); ++characters_number) {
+        i += 1 + Utf8ContinuationBytesNumber(static_cast<unsigned char>(string[i]));
+    }
+    return characters_number;
+}
+
+// Splits pattern by wildcards and returns its pieces together with
+// the offset in pattern of the last character of every piece
+std::vector<std::pair<std::string, size_t>> SplitIntoPieces(const std::string& pattern,
+        char wildcard, Encoding encoding = Encoding::BYTES) {
+    auto patterns_without_wildcard = Split(pattern,
+        [&wildcard](char character) {
+            return character == wildcard;
+        });
+    std::vector<std::pair<std::string, size_t>> pieces;
+    size_t pattern_id = 0;
+    for (const auto& pattern_without_wildcard: patterns_without_wildcard) {
+        pattern_id += CharactersNumber(pattern_without_wildcard, encoding);
+        pieces.emplace_back(pattern_without_wildcard,
+            pattern_id > 0 ? pattern_id - 1 : 0);
+        ++pattern_id;
+    }
+    return pieces;
+}
+
 // Wildcard is a character that may be substituted
-// for any of all possible characters
+// for any of all possible characters.
+// In UTF8 encoding the wildcard stands for one code point, the automaton
+// still runs over bytes and positions are counted in code points.
 class WildcardMatcher {
 public:
     WildcardMatcher():
+        scanned_characters_(0),
+        position_mask_(0),
+        encoding_(Encoding::BYTES),
+        pending_continuation_bytes_(0),
         number_of_words_(0),
         pattern_length_(-1) {
     }
 
-    void Init(const std::string& pattern, char wildcard) {
-        pattern_length_ = pattern.size();
-        auto patterns_without_wildcard = Split(pattern,
-            [&wildcard](char character) {
-                return character == wildcard;
-            });
-        number_of_words_ = patterns_without_wildcard.size();
+    void Init(const std::string& pattern, char wildcard,
+            Encoding encoding = Encoding::BYTES) {
+        encoding_ = encoding;
+        pattern_length_ = CharactersNumber(pattern, encoding);
+        auto pieces = SplitIntoPieces(pattern, wildcard, encoding);
+        number_of_words_ = pieces.size();
         aho_corasick::AutomatonBuilder builder;
-        size_t pattern_id = 0;
-        for (const auto& pattern_without_wildcard: patterns_without_wildcard) {
-            pattern_id += pattern_without_wildcard.size();
-            builder.Add(pattern_without_wildcard,
-                pattern_id > 0 ? pattern_id - 1 : 0);
-            ++pattern_id;
+        for (const auto& piece : pieces) {
+            builder.Add(piece.first, piece.second);
+        }
+        aho_corasick_automaton_ = builder.Build(true);
+        size_t capacity = 1;
+        while (capacity < pattern_length_) {
+            capacity *= 2;
         }
-        aho_corasick_automaton_ = builder.Build();
-        state_ = aho_corasick_automaton_->Root();
+        words_occurrences_by_position_.assign(capacity, 0);
+        position_mask_ = capacity - 1;
+        Reset();
     }
 
     // Resets matcher to start scanning new stream
     void Reset() {
-        words_occurrences_by_position_.clear();
+        scanned_characters_ = 0;
+        pending_continuation_bytes_ = 0;
+        if (aho_corasick_automaton_) {
+            state_ = aho_corasick_automaton_->Root();
+        }
     }
 
     // Scans new character and calls on_match() if
-    // suffix of scanned characters matches pattern
+    // suffix of scanned characters matches pattern.
+    // In UTF8 encoding character is one byte of the text and pieces are
+    // matched only when the last byte of a code point is scanned.
     template <class Callback>
     void Scan(char character, Callback on_match) {
         if (!state_) {
             throw std::logic_error("Wildcard matcher wasn't initialized");
         }
-        words_occurrences_by_position_.push_front(0);
+        if (encoding_ == Encoding::UTF8) {
+            unsigned char byte = static_cast<unsigned char>(character);
+            if ((byte & 0xC0) == 0x80 && pending_continuation_bytes_ > 0) {
+                --pending_continuation_bytes_;
+            } else {
+                pending_continuation_bytes_ = Utf8ContinuationBytesNumber(byte);
+                words_occurrences_by_position_[scanned_characters_ & position_mask_] = 0;
+                ++scanned_characters_;
+            }
+            state_ = state_.Next(character);
+            if (pending_continuation_bytes_ == 0) {
+                FinishCharacter(on_match);
+            }
+            return;
+        }
+        words_occurrences_by_position_[scanned_characters_ & position_mask_] = 0;
+        ++scanned_characters_;
         state_ = state_.Next(character);
+        FinishCharacter(on_match);
+    }
+
+    // Scans next chunk of the stream and calls on_match(position) with
+    // the position in the stream of the first character of every match;
+    // matches may span chunk boundaries
+    template <class Callback>
+    void ScanChunk(const char* data, size_t length, Callback on_match) {
+        for (size_t i = 0; i < length; ++i) {
+            Scan(data[i], [this, &on_match] () {
+                    on_match(scanned_characters_ - pattern_length_);
+                });
+        }
+    }
+
+private:
+    // Counts pieces ending at the last scanned character
+    template <class Callback>
+    void FinishCharacter(Callback on_match) {
+        size_t position = scanned_characters_ - 1;
         aho_corasick_automaton_.get()->GenerateMatches(state_,
-            [this] (size_t id) mutable {
-                if (id < words_occurrences_by_position_.size()) {
-                    ++words_occurrences_by_position_[id];
+            [this, position] (size_t id) {
+                if (id <= position) {
+                    ++words_occurrences_by_position_[(position - id) & position_mask_];
                 }
             });
-        if (words_occurrences_by_position_.size() == pattern_length_) {
-            if (words_occurrences_by_position_.back() == number_of_words_) {
+        if (position + 1 >= pattern_length_) {
+            size_t start = position + 1 - pattern_length_;
+            if (words_occurrences_by_position_[start & position_mask_] == number_of_words_) {
                 on_match();
             }
-            words_occurrences_by_position_.pop_back();
         }
     }
 
-private:
-    std::deque<size_t> words_occurrences_by_position_;
+    // Ring buffer of the last pattern_length_ positions: counter of a window
+    // starting at text position p is stored at index p & position_mask_
+    std::vector<uint32_t> words_occurrences_by_position_;
+    size_t scanned_characters_;
+    size_t position_mask_;
+    Encoding encoding_;
+    // Bytes left to scan of the current UTF-8 code point
+    size_t pending_continuation_bytes_;
     aho_corasick::NodeReference state_;
     size_t number_of_words_;
     size_t pattern_length_;
     std::unique_ptr<aho_corasick::Automaton> aho_corasick_automaton_;
 };
 
+// Matches pattern with wildcards allowing up to mismatches_number substituted
+// characters. By the pigeonhole principle one of mismatches_number + 1 segments
+// of the pattern occurs exactly in every such match, so segment pieces are
+// counted in windows as in WildcardMatcher, and windows where some segment
+// occurs are verified against the last pattern length scanned characters.
+class MismatchesWildcardMatcher {
+public:
+    MismatchesWildcardMatcher():
+        wildcard_('\0'),
+        mismatches_number_(0),
+        has_wildcard_segment_(false),
+        scanned_characters_(0),
+        position_mask_(0) {
+    }
+
+    void Init(const std::string& pattern, char wildcard, size_t mismatches_number) {
+        pattern_ = pattern;
+        wildcard_ = wildcard;
+        mismatches_number_ = mismatches_number;
+        size_t segments_number = std::min(mismatches_number + 1, pattern.size());
+        pieces_.clear();
+        segment_pieces_numbers_.assign(segments_number, 0);
+        // with fewer segments than mismatches_number + 1 any window may match
+        has_wildcard_segment_ = segments_number <= mismatches_number;
+        aho_corasick::AutomatonBuilder builder;
+        for (size_t segment = 0; segment < segments_number; ++segment) {
+            size_t begin = segment * pattern.size() / segments_number;
+            size_t end = (segment + 1) * pattern.size() / segments_number;
+            for (const auto& piece
+                    : SplitIntoPieces(pattern.substr(begin, end - begin), wildcard)) {
+                if (!piece.first.empty()) {
+                    builder.Add(piece.first, pieces_.size());
+                    pieces_.emplace_back(segment, begin + piece.second);
+                    ++segment_pieces_numbers_[segment];
+                }
+            }
+            if (segment_pieces_numbers_[segment] == 0) {
+                has_wildcard_segment_ = true;
+            }
+        }
+        aho_corasick_automaton_ = builder.Build(true);
+        size_t capacity = 1;
+        while (capacity < pattern.size()) {
+            capacity *= 2;
+        }
+        position_mask_ = capacity - 1;
+        last_characters_.assign(capacity, '\0');
+        has_exact_segment_.assign(capacity, false);
+        segments_occurrences_by_position_.assign(segments_number * capacity, 0);
+        Reset();
+    }
+
+    // Resets matcher to start scanning new stream
+    void Reset() {
+        scanned_characters_ = 0;
+        if (aho_corasick_automaton_) {
+            state_ = aho_corasick_automaton_->Root();
+        }
+    }
+
+    // Scans new character and calls on_match() if suffix of scanned
+    // characters differs from pattern in at most mismatches_number characters
+    template <class Callback>
+    void Scan(char character, Callback on_match) {
+        if (!state_) {
+            throw std::logic_error("Wildcard matcher wasn't initialized");
+        }
+        size_t position = scanned_characters_++;
+        size_t capacity = position_mask_ + 1;
+        last_characters_[position & position_mask_] = character;
+        has_exact_segment_[position & position_mask_] = has_wildcard_segment_;
+        for (size_t segment = 0; segment < segment_pieces_numbers_.size(); ++segment) {
+            segments_occurrences_by_position_[segment * capacity
+                + (position & position_mask_)] = 0;
+        }
+        state_ = state_.Next(character);
+        aho_corasick_automaton_->GenerateMatches(state_,
+            [this, position, capacity] (size_t piece_id) {
+                size_t segment = pieces_[piece_id].first;
+                size_t offset = pieces_[piece_id].second;
+                if (offset > position) {
+                    return;
+                }
+                size_t start = position - offset;
+                if (++segments_occurrences_by_position_[segment * capacity
+                        + (start & position_mask_)] == segment_pieces_numbers_[segment]) {
+                    has_exact_segment_[start & position_mask_] = true;
+                }
+            });
+        if (position + 1 >= pattern_.size()) {
+            size_t start = position + 1 - pattern_.size();
+            if (has_exact_segment_[start & position_mask_] && CountMismatches(start)
+                    <= mismatches_number_) {
+                on_match();
+            }
+        }
+    }
+
+private:
+    // Stops counting as soon as mismatches_number_ is exceeded
+    size_t CountMismatches(size_t start) const {
+        size_t mismatches = 0;
+        for (size_t i = 0; i < pattern_.size() && mismatches <= mismatches_number_; ++i) {
+            if (pattern_[i] != wildcard_
+                    && pattern_[i] != last_characters_[(start + i) & position_mask_]) {
+                ++mismatches;
+            }
+        }
+        return mismatches;
+    }
+
+    std::string pattern_;
+    char wildcard_;
+    size_t mismatches_number_;
+    // (segment, offset of the last character) of every non-empty piece
+    std::vector<std::pair<size_t, size_t>> pieces_;
+    std::vector<uint32_t> segment_pieces_numbers_;
+    // Some segment consists of wildcards only and occurs everywhere
+    bool has_wildcard_segment_;
+    size_t scanned_characters_;
+    size_t position_mask_;
+    // Ring buffers indexed by text position & position_mask_
+    std::vector<char> last_characters_;
+    std::vector<bool> has_exact_segment_;
+    // Ring buffer for every segment, one after another
+    std::vector<uint32_t> segments_occurrences_by_position_;
+    aho_corasick::NodeReference state_;
+    std::unique_ptr<aho_corasick::Automaton> aho_corasick_automaton_;
+};
+
+// Matches many wildcard patterns in one pass: pieces of all patterns share
+// one automaton and every pattern keeps its own ring buffer of counters
+class MultiWildcardMatcher {
+public:
+    MultiWildcardMatcher():
+        scanned_characters_(0) {
+    }
+
+    // Pattern ids are indices in patterns, patterns must be non-empty
+    void Init(const std::vector<std::string>& patterns, char wildcard) {
+        patterns_.clear();
+        pieces_.clear();
+        aho_corasick::AutomatonBuilder builder;
+        size_t counters_number = 0;
+        for (size_t pattern_id = 0; pattern_id < patterns.size(); ++pattern_id) {
+            if (patterns[pattern_id].empty()) {
+                throw std::invalid_argument("Wildcard pattern must be non-empty");
+            }
+            auto pieces = SplitIntoPieces(patterns[pattern_id], wildcard);
+            for (const auto& piece : pieces) {
+                builder.Add(piece.first, pieces_.size());
+                pieces_.emplace_back(pattern_id, piece.second);
+            }
+            size_t capacity = 1;
+            while (capacity < patterns[pattern_id].size()) {
+                capacity *= 2;
+            }
+            PatternWindow window;
+            window.length = patterns[pattern_id].size();
+            window.number_of_words = pieces.size();
+            window.counters_begin = counters_number;
+            window.position_mask = capacity - 1;
+            patterns_.push_back(window);
+            counters_number += capacity;
+        }
+        counters_.assign(counters_number, 0);
+        window_starts_.assign(counters_number, kNoPosition);
+        aho_corasick_automaton_ = builder.Build(true);
+        Reset();
+    }
+
+    // Resets matcher to start scanning new stream
+    void Reset() {
+        scanned_characters_ = 0;
+        std::fill(window_starts_.begin(), window_starts_.end(), kNoPosition);
+        if (aho_corasick_automaton_) {
+            state_ = aho_corasick_automaton_->Root();
+        }
+    }
+
+    // Scans new character and calls on_match(pattern_id) for every
+    // pattern matching suffix of scanned characters
+    template <class Callback>
+    void Scan(char character, Callback on_match) {
+        if (!state_) {
+            throw std::logic_error("Wildcard matcher wasn't initialized");
+        }
+        size_t position = scanned_characters_++;
+        state_ = state_.Next(character);
+        aho_corasick_automaton_->GenerateMatches(state_,
+            [this, position, &on_match] (size_t piece_id) {
+                const auto& piece = pieces_[piece_id];
+                if (piece.second > position) {
+                    return;
+                }
+                const PatternWindow& window = patterns_[piece.first];
+                size_t start = position - piece.second;
+                size_t counter = window.counters_begin + (start & window.position_mask);
+                // counters are reset lazily when the window they belong to changes
+                if (window_starts_[counter] != start) {
+                    window_starts_[counter] = start;
+                    counters_[counter] = 0;
+                }
+                // the last piece ends at the last character of the window,
+                // so the counter completes exactly when the pattern matches
+                if (++counters_[counter] == window.number_of_words) {
+                    on_match(piece.first);
+                }
+            });
+    }
+
+private:
+    static const size_t kNoPosition = SIZE_MAX;
+
+    struct PatternWindow {
+        size_t length;
+        uint32_t number_of_words;
+        size_t counters_begin;
+        size_t position_mask;
+    };
+
+    std::vector<PatternWindow> patterns_;
+    // (pattern id, offset of the last character) of every piece
+    std::vector<std::pair<size_t, size_t>> pieces_;
+    std::vector<uint32_t> counters_;
+    // start of the window every counter currently belongs to
+    std::vector<size_t> window_starts_;
+    size_t scanned_characters_;
+    aho_corasick::NodeReference state_;
+    std::unique_ptr<aho_corasick::Automaton> aho_corasick_automaton_;
+};
+
+const size_t MultiWildcardMatcher::kNoPosition;
+
 std::string ReadString(std::istream& input_stream) {
     std::string string;
     input_stream >> string;
     return string;
 }
 
-// Returns positions of the first character of every match
-std::vector<size_t> FindFuzzyMatches(const std::string& patternWithWildcards,
-        const std::string& text, char wildcard) {
+// Finds positions where the longest piece of a wildcard pattern may occur
+// by comparing its first two characters with 16 bytes of text at once;
+// every match of the pattern contains such a position
+class LiteralPrefilter {
+public:
+    LiteralPrefilter():
+        piece_length_(0),
+        piece_offset_(0),
+        first_character_('\0'),
+        second_character_('\0') {
+    }
+
+    void Init(const std::string& pattern, char wildcard) {
+        piece_length_ = 0;
+        for (const auto& piece : SplitIntoPieces(pattern, wildcard)) {
+            if (piece.first.size() > piece_length_) {
+                piece_length_ = piece.first.size();
+                piece_offset_ = piece.second + 1 - piece.first.size();
+                first_character_ = piece.first[0];
+                second_character_ = piece.first.size() > 1 ? piece.first[1] : '\0';
+            }
+        }
+    }
+
+    // Pattern without literal characters cannot be prefiltered
+    explicit operator bool() const {
+        return piece_length_ > 0;
+    }
+
+    // Offset of the chosen piece in pattern
+    size_t PieceOffset() const {
+        return piece_offset_;
+    }
+
+    // Calls on_candidate(position) in ascending order for every position
+    // of [begin, end) where the chosen piece may start
+    template <class Callback>
+    void FindCandidates(const char* begin, const char* end, Callback on_candidate) const {
+        size_t length = end - begin;
+        size_t position = 0;
+        bool two_characters = piece_length_ > 1;
+#ifdef __SSE2__
+        const size_t kBlockSize = 16;
+        const __m128i first = _mm_set1_epi8(first_character_);
+        const __m128i second = _mm_set1_epi8(second_character_);
+        for (; position + kBlockSize + 1 <= length; position += kBlockSize) {
+            __m128i block = _mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(begin + position));
+            __m128i matches = _mm_cmpeq_epi8(block, first);
+            if (two_characters) {
+                __m128i next_block = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(begin + position + 1));
+                matches = _mm_and_si128(matches, _mm_cmpeq_epi8(next_block, second));
+            }
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(matches));
+            while (mask != 0) {
+                on_candidate(position + __builtin_ctz(mask));
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; position < length; ++position) {
+            if (begin[position] == first_character_ && (!two_characters
+                    || (position + 1 < length && begin[position + 1] == second_character_))) {
+                on_candidate(position);
+            }
+        }
+    }
+
+private:
+    size_t piece_length_;
+    size_t piece_offset_;
+    char first_character_;
+    char second_character_;
+};
+
+// Appends positions of the first character of every match starting
+// in [begin, end) to occurrences; the text is scanned only up to
+// end + pattern length - 1. Matcher is run only over windows of
+// pattern length around candidates found by LiteralPrefilter.
+void FindFuzzyMatchesStartingInRange(const std::string& patternWithWildcards,
+        const std::string& text, char wildcard, size_t begin, size_t end,
+        std::vector<size_t>* occurrences) {
     size_t patternLength = patternWithWildcards.length();
+    size_t scanEnd = std::min(text.size(), end + patternLength - 1);
     WildcardMatcher matcher;
     matcher.Init(patternWithWildcards, wildcard);
+    auto scan = [&matcher, &text, occurrences, patternLength] (size_t offset) {
+        matcher.Scan(text[offset], [occurrences, offset, patternLength] () {
+                occurrences->push_back(offset + 1 - patternLength);
+            });
+    };
+    LiteralPrefilter prefilter;
+    prefilter.Init(patternWithWildcards, wildcard);
+    if (!prefilter) {
+        for (size_t offset = begin; offset < scanEnd; ++offset) {
+            scan(offset);
+        }
+        return;
+    }
+    size_t pieceOffset = prefilter.PieceOffset();
+    // matcher has scanned text up to this position since its last reset
+    size_t scannedUntil = begin;
+    prefilter.FindCandidates(text.data() + begin, text.data() + scanEnd,
+        [&] (size_t candidate) {
+            candidate += begin;
+            if (candidate < begin + pieceOffset || candidate - pieceOffset >= end) {
+                return;
+            }
+            size_t start = candidate - pieceOffset;
+            size_t windowEnd = std::min(start + patternLength, scanEnd);
+            if (start >= scannedUntil) {
+                matcher.Reset();
+                scannedUntil = start;
+            }
+            for (; scannedUntil < windowEnd; ++scannedUntil) {
+                scan(scannedUntil);
+            }
+        });
+}
+
+// Returns positions of the first character of every match.
+// With several threads the text is split into chunks of match starts,
+// every thread scans its chunk and pattern length - 1 characters after it
+// with its own matcher, so chunk results are disjoint and already sorted.
+std::vector<size_t> FindFuzzyMatches(const std::string& patternWithWildcards,
+        const std::string& text, char wildcard, size_t threadsNumber = 1) {
+    threadsNumber = std::max<size_t>(1, std::min(threadsNumber, text.size()));
+    if (threadsNumber == 1) {
+        std::vector<size_t> occurrences;
+        FindFuzzyMatchesStartingInRange(patternWithWildcards, text, wildcard,
+            0, text.size(), &occurrences);
+        return occurrences;
+    }
+    size_t chunkSize = (text.size() + threadsNumber - 1) / threadsNumber;
+    std::vector<std::vector<size_t>> occurrencesByChunk(threadsNumber);
+    std::vector<std::thread> threads;
+    for (size_t chunk = 0; chunk < threadsNumber; ++chunk) {
+        size_t begin = std::min(text.size(), chunk * chunkSize);
+        size_t end = std::min(text.size(), begin + chunkSize);
+        threads.emplace_back(FindFuzzyMatchesStartingInRange, std::cref(patternWithWildcards),
+            std::cref(text), wildcard, begin, end, &occurrencesByChunk[chunk]);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    std::vector<size_t> occurrences;
+    for (const auto& chunkOccurrences : occurrencesByChunk) {
+        occurrences.insert(occurrences.end(), chunkOccurrences.begin(), chunkOccurrences.end());
+    }
+    return occurrences;
+}
+
+// Returns positions of the first character of every match
+// with at most mismatchesNumber substituted characters
+std::vector<size_t> FindFuzzyMatchesWithMismatches(const std::string& patternWithWildcards,
+        const std::string& text, char wildcard, size_t mismatchesNumber) {
+    size_t patternLength = patternWithWildcards.length();
+    MismatchesWildcardMatcher matcher;
+    matcher.Init(patternWithWildcards, wildcard, mismatchesNumber);
     std::vector<size_t> occurrences;
     for (size_t offset = 0; offset < text.size(); ++offset) {
         matcher.Scan(text[offset], [&occurrences, offset, patternLength] () {
@@ -445,19 +1484,116 @@ std::vector<size_t> FindFuzzyMatches(const std::string& patternWithWildcards,
     return occurrences;
 }
 
-template <class Type>
-void Print(const std::vector<Type>& sequence) {
-    std::cout << sequence.size() << std::endl;
-    for (const auto &element : sequence) {
-        std::cout << element << " ";
+// Returns positions in code points of the first code point of every match,
+// wildcard matches one code point of UTF-8 text
+std::vector<size_t> FindFuzzyMatchesInUtf8(const std::string& patternWithWildcards,
+        const std::string& text, char wildcard) {
+    WildcardMatcher matcher;
+    matcher.Init(patternWithWildcards, wildcard, Encoding::UTF8);
+    std::vector<size_t> occurrences;
+    matcher.ScanChunk(text.data(), text.size(), [&occurrences] (size_t position) {
+            occurrences.push_back(position);
+        });
+    return occurrences;
+}
+
+// Returns (pattern id, position of the first character) of every match
+// ordered by position of the last character of the match
+std::vector<std::pair<size_t, size_t>> FindFuzzyMatchesOfPatterns(
+        const std::vector<std::string>& patternsWithWildcards,
+        const std::string& text, char wildcard) {
+    MultiWildcardMatcher matcher;
+    matcher.Init(patternsWithWildcards, wildcard);
+    std::vector<std::pair<size_t, size_t>> occurrences;
+    for (size_t offset = 0; offset < text.size(); ++offset) {
+        matcher.Scan(text[offset], [&occurrences, &patternsWithWildcards, offset] (size_t id) {
+                occurrences.emplace_back(id, offset + 1 - patternsWithWildcards[id].length());
+            });
     }
-    std::cout << std::endl;
+    return occurrences;
+}
+
+// Writes positions separated by spaces through a buffer of fixed size
+class BufferedPositionsWriter {
+public:
+    explicit BufferedPositionsWriter(std::ostream& output_stream,
+            size_t buffer_size = 1 << 16):
+        output_stream_(output_stream),
+        buffer_size_(buffer_size) {
+        buffer_.reserve(buffer_size_);
+    }
+
+    ~BufferedPositionsWriter() {
+        Flush();
+    }
+
+    void operator()(size_t position) {
+        buffer_ += std::to_string(position);
+        buffer_ += ' ';
+        if (buffer_.size() >= buffer_size_) {
+            Flush();
+        }
+    }
+
+    void Flush() {
+        output_stream_.write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+
+private:
+    std::ostream& output_stream_;
+    size_t buffer_size_;
+    std::string buffer_;
+
+    BufferedPositionsWriter(const BufferedPositionsWriter&) = delete;
+    BufferedPositionsWriter& operator=(const BufferedPositionsWriter&) = delete;
+};
+
+// Reads input_stream by blocks of block_size characters and passes them to
+// matcher up to the first whitespace character or the end of the stream,
+// so memory does not depend on the length of the text.
+// Calls on_match(position) for every match (pass writers by std::ref)
+// and returns number of scanned characters.
+template <class Callback>
+size_t ScanStream(std::istream& input_stream, WildcardMatcher* matcher,
+        Callback on_match, size_t block_size = 1 << 20) {
+    std::vector<char> block(block_size);
+    size_t scanned_characters = 0;
+    while (input_stream) {
+        input_stream.read(block.data(), block.size());
+        char* end = block.data() + input_stream.gcount();
+        char* text_end = std::find_if(block.data(), end,
+            [] (char character) {
+                return std::isspace(static_cast<unsigned char>(character)) != 0;
+            });
+        size_t length = static_cast<size_t>(text_end - block.data());
+        matcher->ScanChunk(block.data(), length, std::ref(on_match));
+        scanned_characters += length;
+        if (text_end != end) {
+            break;
+        }
+    }
+    return scanned_characters;
 }
 
 int main() {
     const char wildcard = '?';
     const std::string patternWithWildcards = ReadString(std::cin);
-    const std::string text = ReadString(std::cin);
-    Print(FindFuzzyMatches(patternWithWildcards, text, wildcard));
+    WildcardMatcher matcher;
+    matcher.Init(patternWithWildcards, wildcard);
+    // the text is scanned while it is read, only the matches are kept
+    // since their number is printed first
+    std::vector<size_t> occurrences;
+    ScanStream(std::cin >> std::ws, &matcher, [&occurrences] (size_t position) {
+            occurrences.push_back(position);
+        });
+    std::cout << occurrences.size() << std::endl;
+    {
+        BufferedPositionsWriter writer(std::cout);
+        for (size_t position : occurrences) {
+            writer(position);
+        }
+    }
+    std::cout << std::endl;
     return 0;
 }
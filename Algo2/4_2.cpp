@@ -1,10 +1,20 @@
 #include <iostream>
 #include <vector>
 #include <algorithm>
-#include <unordered_set>
-#include <iterator>
+#include <atomic>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <mutex>
 #include <set>
-#include <boost/range/counting_range.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <iterator>
+#include <utility>
 
 using std::vector;
 
@@ -25,6 +35,20 @@ private:
     Iterator begin_, end_;
 };
 
+// Calls function(thread_index) for every thread_index in [0, threads_number),
+// index 0 in the calling thread, and waits for all of them
+template <class Function>
+void RunInParallel(int threads_number, Function function) {
+    vector<std::thread> threads;
+    for (int thread_index = 1; thread_index < threads_number; ++thread_index) {
+        threads.emplace_back(function, thread_index);
+    }
+    function(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
 namespace graph {
     
     template <class Edge>
@@ -108,160 +132,911 @@ namespace graph {
         int target;
     };
 
+    // Edge of CompressedGraph, its source is the vertex whose outgoing edges contain it
+    struct TargetEdge {
+        TargetEdge() : target(-1) {}
+
+        explicit TargetEdge(int target) : target(target) {}
+
+        int GetTarget() const {
+            return target;
+        }
+
+        int target;
+    };
+
+    // Graph in compressed sparse row form: edges outgoing from vertex are
+    // edges[offsets[vertex]..offsets[vertex + 1]) of one array
+    class CompressedGraph {
+    public:
+        typedef IteratorRange<vector<TargetEdge>::const_iterator> OutEdgesRange;
+        typedef TargetEdge EdgeType;
+        typedef int VertexType;
+
+        CompressedGraph() : offsets(1, 0) {}
+
+        // Sorts edges by source with a counting sort keeping their order
+        // for every source, edges are iterated twice
+        template <class Iterator>
+        CompressedGraph(size_t vertexes_number, IteratorRange<Iterator> edges) {
+            offsets.assign(vertexes_number + 1, 0);
+            for (const auto& edge : edges) {
+                ++offsets[edge.GetSource() + 1];
+            }
+            for (size_t vertex = 0; vertex < vertexes_number; ++vertex) {
+                offsets[vertex + 1] += offsets[vertex];
+            }
+            this->edges.resize(offsets[vertexes_number]);
+            vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+            for (const auto& edge : edges) {
+                this->edges[positions[edge.GetSource()]++] = TargetEdge(edge.GetTarget());
+            }
+        }
+
+        // offsets must have vertexes number + 1 nondecreasing elements
+        // from 0 to edges.size()
+        CompressedGraph(vector<size_t> offsets, vector<TargetEdge> edges) :
+            offsets(std::move(offsets)), edges(std::move(edges)) {}
+
+        OutEdgesRange OutgoingEdges(VertexType vertex) const {
+            return OutEdgesRange(edges.begin() + offsets[vertex],
+                                edges.begin() + offsets[vertex + 1]);
+        }
+
+        size_t GetOutValency(VertexType vertex) const {
+            return offsets[vertex + 1] - offsets[vertex];
+        }
+
+        size_t VertexesNumber() const {
+            return offsets.size() - 1;
+        }
+
+        size_t EdgesNumber() const {
+            return edges.size();
+        }
+
+        // All edges ordered by source, for scans which don't need sources
+        OutEdgesRange Edges() const {
+            return OutEdgesRange(edges.begin(), edges.end());
+        }
+
+    private:
+        vector<size_t> offsets;
+        vector<TargetEdge> edges;
+    };
+
+    // Counts incoming edges of every vertex and scatters sources into
+    // their targets' rows, O(V + E)
+    inline CompressedGraph TransposeGraph(const CompressedGraph& graph) {
+        int vertexes_number = static_cast<int>(graph.VertexesNumber());
+        vector<size_t> offsets(vertexes_number + 1, 0);
+        for (int vertex = 0; vertex < vertexes_number; ++vertex) {
+            for (const auto& edge : graph.OutgoingEdges(vertex)) {
+                ++offsets[edge.GetTarget() + 1];
+            }
+        }
+        for (int vertex = 0; vertex < vertexes_number; ++vertex) {
+            offsets[vertex + 1] += offsets[vertex];
+        }
+        vector<TargetEdge> edges(graph.EdgesNumber());
+        vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+        for (int vertex = 0; vertex < vertexes_number; ++vertex) {
+            for (const auto& edge : graph.OutgoingEdges(vertex)) {
+                edges[positions[edge.GetTarget()]++] = TargetEdge(vertex);
+            }
+        }
+        return CompressedGraph(std::move(offsets), std::move(edges));
+    }
+
+    // Builds CompressedGraph from edges passed twice in the same order: first
+    // sources of all edges are counted, then edges are written into their rows,
+    // so edges are never stored apart from the graph
+    class CompressedGraphBuilder {
+    public:
+        explicit CompressedGraphBuilder(size_t vertexes_number) :
+            offsets(vertexes_number + 1, 0) {}
+
+        void CountEdge(int source) {
+            ++offsets[source + 1];
+        }
+
+        void StartFilling() {
+            for (size_t vertex = 1; vertex < offsets.size(); ++vertex) {
+                offsets[vertex] += offsets[vertex - 1];
+            }
+            edges.resize(offsets.back());
+        }
+
+        // offsets[source] is the next free position of the row while filling
+        void AddEdge(int source, int target) {
+            edges[offsets[source]++] = TargetEdge(target);
+        }
+
+        CompressedGraph Build() {
+            // after filling offsets[vertex] is the end of the row, i.e. the beginning
+            // of the next one
+            for (size_t vertex = offsets.size() - 1; vertex > 0; --vertex) {
+                offsets[vertex] = offsets[vertex - 1];
+            }
+            offsets[0] = 0;
+            return CompressedGraph(std::move(offsets), std::move(edges));
+        }
+
+    private:
+        vector<size_t> offsets;
+        vector<TargetEdge> edges;
+    };
+
 } // namespace graph
 
 namespace traverses {
 
+    // The depth-first traversal below is library code for visitors: main does not
+    // run it, components are found by the specialised searches in components_builder
+    // and incoming valencies by ScanEdges.
+
+    // Visits vertexes reachable from origin_vertex which are not visited yet;
+    // the stack keeps vertexes with positions of their next edges instead of recursion
+    template<class Visitor, class Graph, class Vertex>
+    void DepthFirstSearchComponent(Vertex origin_vertex,
+                Visitor& visitor,
+                const Graph& graph,
+                vector<bool>& visited_vertexes,
+                vector<std::pair<Vertex, size_t>>& stack) {
+        visitor.DiscoverVertex(origin_vertex);
+        visited_vertexes[origin_vertex] = true;
+        stack.emplace_back(origin_vertex, 0);
+
+        while (!stack.empty()) {
+            Vertex vertex = stack.back().first;
+            auto edges = graph.OutgoingEdges(vertex);
+            auto edge = edges.begin() + stack.back().second;
+            for (; edge != edges.end(); ++edge) {
+                visitor.DiscoverVertexForIncomingValency(edge->GetTarget());
+                if (!visited_vertexes[edge->GetTarget()]) {
+                    break;
+                }
+            }
+            if (edge == edges.end()) {
+                visitor.FinishVertex(vertex);
+                stack.pop_back();
+                continue;
+            }
+            stack.back().second = edge - edges.begin() + 1;
+            Vertex target = edge->GetTarget();
+            visitor.DiscoverVertex(target);
+            visited_vertexes[target] = true;
+            stack.emplace_back(target, 0);
+        }
+    }
+
     template<class Visitor, class Graph, class VertexIterator>
     void DepthFirstSearchGraph(Visitor& visitor,
                         const Graph& graph,
                         VertexIterator begin,
                         VertexIterator end) {
-
-        std::unordered_set<typename Graph::VertexType> visited_vertexes;
+        typedef typename Graph::VertexType Vertex;
+        vector<bool> visited_vertexes(graph.VertexesNumber(), false);
+        vector<std::pair<Vertex, size_t>> stack;
 
         for (; begin != end; ++begin) {
-            if (visited_vertexes.count(*begin) == 0) {
+            if (!visited_vertexes[*begin]) {
                 visitor.DiscoverComponent();
-                DepthFirstSearchComponent(*begin, visitor, graph, visited_vertexes);
+                DepthFirstSearchComponent(static_cast<Vertex>(*begin), visitor, graph,
+                                        visited_vertexes, stack);
             }
         }
     }
 
-    template<class Visitor, class Graph, class Vertex>
-    void DepthFirstSearchComponent(Vertex origin_vertex,
-                Visitor& visitor,
-                const Graph& graph,
-                std::unordered_set<Vertex>& visited_vertexes) {
-        visitor.DiscoverVertex(origin_vertex);
-        visited_vertexes.insert(origin_vertex);
-        
-        for (const auto &edge : graph.OutgoingEdges(origin_vertex)) {
-            Vertex target = edge.GetTarget();
-            visitor.DiscoverVertexForIncomingValency(target);
-            if (visited_vertexes.count(target) == 0) {
-                DepthFirstSearchComponent(target, visitor, graph, visited_vertexes);
+    // Reports every edge's target to the visitor in order of sources
+    // without keeping visited vertexes, for visitors which only count edges
+    template<class Visitor, class Graph>
+    void ScanEdges(Visitor& visitor, const Graph& graph) {
+        typedef typename Graph::VertexType Vertex;
+        Vertex vertexes_number = static_cast<Vertex>(graph.VertexesNumber());
+        for (Vertex vertex = 0; vertex < vertexes_number; ++vertex) {
+            for (const auto& edge : graph.OutgoingEdges(vertex)) {
+                visitor.DiscoverVertexForIncomingValency(edge.GetTarget());
             }
         }
-        
-        visitor.FinishVertex(origin_vertex);
     }
 
+    // Default hooks for visitors of the traversals above. Traversals are templates
+    // over the visitor type, so hooks are hidden in derived visitors rather than
+    // overridden and are called without indirection; unused ones compile to nothing
     template<class Vertex>
     class DfsVisitor {
     public:
-        virtual void DiscoverVertex(Vertex /*vertex*/) {}
-        virtual void FinishVertex(Vertex /*vertex*/) {}
-        virtual void DiscoverVertexForIncomingValency(Vertex /*vertex*/) {}
-        virtual void DiscoverComponent() {}
-        virtual ~DfsVisitor() {}
+        void DiscoverVertex(Vertex /*vertex*/) {}
+        void FinishVertex(Vertex /*vertex*/) {}
+        void DiscoverVertexForIncomingValency(Vertex /*vertex*/) {}
+        void DiscoverComponent() {}
+
+    protected:
+        ~DfsVisitor() {}
     };
 
 } // namespace traverses
 
 namespace components_builder {
 
-    template <class Iterator>
-    class OrderBuilder : public traverses::DfsVisitor<int> {
+    // функция возвращает массив размера кол-во вершин; массив описывает принадлежность
+    // вершины соответствующей компоненте сильной связности; компоненты пронумерованы
+    // в топологическом порядке графа конденсации.
+    // Итеративный алгоритм Пирса (вариант Тарьяна): rindex[v] хранит номер обхода
+    // вершины, пока её компонента не найдена, затем - номер компоненты, отсчитываемый
+    // от vertexes_number - 1 вниз, поэтому отдельный массив компонент не нужен
+    template <class Graph>
+    vector<int> FindStronglyConnectedComponents(const Graph& graph) {
+        int vertexes_number = static_cast<int>(graph.VertexesNumber());
+        vector<int> rindex(vertexes_number, 0);
+        vector<bool> is_root(vertexes_number, false);
+        vector<int> vertexes_stack;
+        vector<int> dfs_stack;
+        vector<size_t> edge_positions;
+        int index = 1;
+        int component = vertexes_number - 1;
+
+        for (int origin = 0; origin < vertexes_number; ++origin) {
+            if (rindex[origin] != 0) {
+                continue;
+            }
+            dfs_stack.push_back(origin);
+            edge_positions.push_back(0);
+            is_root[origin] = true;
+            rindex[origin] = index++;
+            while (!dfs_stack.empty()) {
+                int vertex = dfs_stack.back();
+                size_t& position = edge_positions.back();
+                auto edges = graph.OutgoingEdges(vertex);
+                auto edge = edges.begin() + position;
+                for (; edge != edges.end(); ++edge) {
+                    int target = edge->GetTarget();
+                    if (rindex[target] == 0) {
+                        break;
+                    }
+                    if (rindex[target] < rindex[vertex]) {
+                        rindex[vertex] = rindex[target];
+                        is_root[vertex] = false;
+                    }
+                }
+                position = edge - edges.begin();
+                if (edge != edges.end()) { // спуск в непосещённую вершину
+                    int target = edge->GetTarget();
+                    dfs_stack.push_back(target);
+                    edge_positions.push_back(0);
+                    is_root[target] = true;
+                    rindex[target] = index++;
+                    continue;
+                }
+                dfs_stack.pop_back();
+                edge_positions.pop_back();
+                if (!is_root[vertex]) {
+                    vertexes_stack.push_back(vertex);
+                    continue;
+                }
+                --index;
+                while (!vertexes_stack.empty() && rindex[vertex] <= rindex[vertexes_stack.back()]) {
+                    rindex[vertexes_stack.back()] = component;
+                    vertexes_stack.pop_back();
+                    --index;
+                }
+                rindex[vertex] = component;
+                --component;
+            }
+        }
+
+        // компоненты найдены в обратном топологическом порядке
+        for (int& vertex_component : rindex) {
+            vertex_component -= component + 1;
+        }
+        return rindex;
+    }
+
+    // Разбиение на компоненты сильной связности в несколько потоков методом
+    // forward-backward: для подмножества вершин одного цвета из случайной опорной
+    // вершины ищутся достижимые вперёд (F) и назад (B) вершины, F ∩ B - компонента,
+    // а F \ B, B \ F и остаток не связаны общими компонентами и обрабатываются
+    // независимыми задачами общего пула. Перед этим параллельно отсекаются вершины
+    // без входящих или исходящих рёбер, каждая из них - отдельная компонента
+    template <class Graph>
+    class ParallelComponentsFinder {
     public:
-        explicit OrderBuilder(Iterator position) : position(position) {}
+        ParallelComponentsFinder(const Graph& graph, int threads_number) :
+            graph(graph),
+            transposed_graph(graph::TransposeGraph(graph)),
+            threads_number(std::max(threads_number, 1)),
+            colors(graph.VertexesNumber()),
+            components(graph.VertexesNumber(), -1),
+            colors_number(1),
+            components_number(0),
+            pending_tasks_number(0) {
+        }
+
+        // номера компонент плотные, в порядке первого появления вершины
+        vector<int> Find() {
+            int vertexes_number = static_cast<int>(graph.VertexesNumber());
+            RunInParallel(threads_number, [this, vertexes_number](int thread_index) {
+                for (int vertex = Begin(thread_index, vertexes_number);
+                        vertex < Begin(thread_index + 1, vertexes_number); ++vertex) {
+                    colors[vertex].store(0, std::memory_order_relaxed);
+                }
+            });
+            Trim();
+
+            Task task;
+            task.color = 0;
+            for (int vertex = 0; vertex < vertexes_number; ++vertex) {
+                if (components[vertex] == -1) {
+                    task.vertexes.push_back(vertex);
+                }
+            }
+            if (!task.vertexes.empty()) {
+                AddTask(std::move(task));
+                RunInParallel(threads_number, [this](int /*thread_index*/) {
+                    ProcessTasks();
+                });
+            }
 
-        void FinishVertex(int vertex) {
-            *position = vertex;
-            ++position;
+            vector<int> labels(components_number.load(), -1);
+            int labels_number = 0;
+            for (int& component : components) {
+                if (labels[component] == -1) {
+                    labels[component] = labels_number++;
+                }
+                component = labels[component];
+            }
+            return components;
         }
 
     private:
-        Iterator position;
-    };
+        static const int kRemovedColor = -1;
+        static const int kNoColor = -2;
+        static const int kMaxTrimRounds = 16;
+
+        struct Task {
+            int color;
+            vector<int> vertexes;
+        };
+
+        int Begin(int thread_index, int vertexes_number) const {
+            return static_cast<int>(static_cast<long long>(vertexes_number)
+                                    * thread_index / threads_number);
+        }
 
-    class ComponentsBuilder {
-    public:
-        explicit ComponentsBuilder(size_t vertexes_number) : current_components_number(-1) {
-            components.resize(vertexes_number);
+        int Color(int vertex) const {
+            return colors[vertex].load(std::memory_order_relaxed);
         }
 
-        void AddComponent() {
-            ++current_components_number;
+        void SetColor(int vertex, int color) {
+            colors[vertex].store(color, std::memory_order_relaxed);
         }
 
-        void AddVertexToLastComponent(int vertex) {
-            components[vertex] = current_components_number;
+        template <class SomeGraph>
+        bool HasNeighbourOfColor(const SomeGraph& some_graph, int vertex, int color) const {
+            for (const auto& edge : some_graph.OutgoingEdges(vertex)) {
+                if (edge.GetTarget() != vertex && Color(edge.GetTarget()) == color) {
+                    return true;
+                }
+            }
+            return false;
         }
 
-        vector<int> GetComponents() const {
-            return components;
+        // раунды отсечения, пока они убирают заметную долю вершин; вершина, все соседи
+        // которой с одной стороны уже отсечены, не лежит на цикле с оставшимися
+        void Trim() {
+            int vertexes_number = static_cast<int>(graph.VertexesNumber());
+            size_t remaining_number = vertexes_number;
+            for (int round = 0; round < kMaxTrimRounds && remaining_number > 0; ++round) {
+                std::atomic<size_t> trimmed_number(0);
+                RunInParallel(threads_number, [this, vertexes_number, &trimmed_number](int thread_index) {
+                    size_t trimmed = 0;
+                    for (int vertex = Begin(thread_index, vertexes_number);
+                            vertex < Begin(thread_index + 1, vertexes_number); ++vertex) {
+                        if (Color(vertex) == 0
+                                && (!HasNeighbourOfColor(graph, vertex, 0)
+                                    || !HasNeighbourOfColor(transposed_graph, vertex, 0))) {
+                            SetColor(vertex, kRemovedColor);
+                            components[vertex] = components_number++;
+                            ++trimmed;
+                        }
+                    }
+                    trimmed_number += trimmed;
+                });
+                remaining_number -= trimmed_number;
+                if (trimmed_number.load() * 100 < remaining_number) {
+                    break;
+                }
+            }
         }
 
-    private:
-        int current_components_number;
-        vector<int> components;
-    };
+        void AddTask(Task&& task) {
+            std::lock_guard<std::mutex> lock(tasks_mutex);
+            tasks.push_back(std::move(task));
+            ++pending_tasks_number;
+            tasks_condition.notify_one();
+        }
 
-    template <class Builder>
-    class ComponentsBuilderVisitor : public traverses::DfsVisitor<int> {
-    public:
-        explicit ComponentsBuilderVisitor(Builder* builder) : builder(builder) {}
+        void ProcessTasks() {
+            while (true) {
+                Task task;
+                {
+                    std::unique_lock<std::mutex> lock(tasks_mutex);
+                    tasks_condition.wait(lock, [this]() {
+                        return !tasks.empty() || pending_tasks_number == 0;
+                    });
+                    if (tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.back());
+                    tasks.pop_back();
+                }
+                ProcessTask(task);
+                std::lock_guard<std::mutex> lock(tasks_mutex);
+                if (--pending_tasks_number == 0) {
+                    tasks_condition.notify_all();
+                }
+            }
+        }
 
-        void DiscoverVertex(int vertex) {
-            builder->AddVertexToLastComponent(vertex);
+        // обход в ширину по вершинам цвета from_color, перекрашивает их в to_color;
+        // если задан component_color, вершины этого цвета попадают в компоненту component
+        template <class SomeGraph>
+        void Reach(const SomeGraph& some_graph, int pivot, int from_color, int to_color,
+                    int component_color, int component, vector<int>* queue) {
+            queue->assign(1, pivot);
+            for (size_t head = 0; head < queue->size(); ++head) {
+                for (const auto& edge : some_graph.OutgoingEdges((*queue)[head])) {
+                    int target = edge.GetTarget();
+                    int color = Color(target);
+                    if (color == from_color) {
+                        SetColor(target, to_color);
+                        queue->push_back(target);
+                    } else if (color == component_color) {
+                        SetColor(target, kRemovedColor);
+                        components[target] = component;
+                        queue->push_back(target);
+                    }
+                }
+            }
         }
 
-        void DiscoverComponent() {
-            builder->AddComponent();
+        void ProcessTask(const Task& task) {
+            // номера цветов не повторяются, поэтому задачи не видят чужих вершин
+            uint32_t hash = static_cast<uint32_t>(task.color) * 2654435761u;
+            int pivot = task.vertexes[hash % task.vertexes.size()];
+            int forward_color = colors_number++;
+            int backward_color = colors_number++;
+            int component = components_number++;
+            vector<int> queue;
+
+            SetColor(pivot, forward_color);
+            Reach(graph, pivot, task.color, forward_color, kNoColor, -1, &queue);
+            SetColor(pivot, kRemovedColor);
+            components[pivot] = component;
+            Reach(transposed_graph, pivot, task.color, backward_color,
+                    forward_color, component, &queue);
+
+            Task subtasks[3];
+            subtasks[0].color = forward_color;
+            subtasks[1].color = backward_color;
+            subtasks[2].color = task.color;
+            for (int vertex : task.vertexes) {
+                for (auto& subtask : subtasks) {
+                    if (Color(vertex) == subtask.color) {
+                        subtask.vertexes.push_back(vertex);
+                    }
+                }
+            }
+            for (auto& subtask : subtasks) {
+                if (!subtask.vertexes.empty()) {
+                    AddTask(std::move(subtask));
+                }
+            }
         }
 
-    private:
-        Builder* builder;
+        const Graph& graph;
+        Graph transposed_graph;
+        int threads_number;
+        vector<std::atomic<int>> colors;
+        vector<int> components;
+        std::atomic<int> colors_number;
+        std::atomic<int> components_number;
+
+        std::mutex tasks_mutex;
+        std::condition_variable tasks_condition;
+        vector<Task> tasks;
+        size_t pending_tasks_number;
     };
 
-    // функция возвращает массив размера кол-во вершин; массив описывает принадлежность
-    // вершины соответствующей компоненте сильной связности
     template <class Graph>
-    vector<int> FindStronglyConnectedComponents(const Graph& graph) {
-        vector<int> backward_order(graph.VertexesNumber());
-        OrderBuilder<vector<int>::iterator> order_builder(backward_order.begin());
-        { // прямой обход 
-            traverses::DepthFirstSearchGraph(order_builder,
-                                            graph,
-                                            boost::counting_iterator<int>(0),
-                                            boost::counting_iterator<int>(graph.VertexesNumber()));
-        }
-        { // обратный обход
-            std::reverse(backward_order.begin(), backward_order.end());
-            ComponentsBuilder components_builder(graph.VertexesNumber());
-            ComponentsBuilderVisitor<ComponentsBuilder>
-                components_builder_visitor(&components_builder);
-            traverses::DepthFirstSearchGraph(components_builder_visitor,
-                                            graph::TransposeGraph(graph),
-                                            backward_order.begin(),
-                                            backward_order.end());
-            return components_builder.GetComponents();
-        }
+    vector<int> FindStronglyConnectedComponentsInParallel(const Graph& graph,
+                                                        int threads_number) {
+        ParallelComponentsFinder<Graph> finder(graph, threads_number);
+        return finder.Find();
     }
 
+    // рёбра между компонентами раскладываются по компонентам-источникам сортировкой
+    // подсчётом, повторы в строке убираются по отметке последнего источника цели
     template <class Graph>
-    graph::Graph<graph::Edge> CondenceGraph(const vector<int>& components,
-                                            const Graph& initial_graph) {
+    graph::CompressedGraph CondenceGraph(const vector<int>& components,
+                                        const Graph& initial_graph) {
         int components_number = *std::max_element(components.begin(), components.end()) + 1;
         int vertexes_number = static_cast<int>(initial_graph.VertexesNumber());
-        std::set<graph::Edge> edges_in_condence_graph;
 
+        vector<size_t> offsets(components_number + 1, 0);
         for (int vertex = 0; vertex < vertexes_number; ++vertex) {
             for (const auto& edge : initial_graph.OutgoingEdges(vertex)) {
-                if (components[edge.GetSource()] != components[edge.GetTarget()]) {
-                   edges_in_condence_graph.insert(graph::Edge(components[edge.GetSource()],
-                                                                components[edge.GetTarget()]));
-               }
+                if (components[vertex] != components[edge.GetTarget()]) {
+                    ++offsets[components[vertex] + 1];
+                }
+            }
+        }
+        for (int component = 0; component < components_number; ++component) {
+            offsets[component + 1] += offsets[component];
+        }
+        vector<graph::TargetEdge> edges(offsets[components_number]);
+        vector<size_t> positions(offsets.begin(), offsets.end() - 1);
+        for (int vertex = 0; vertex < vertexes_number; ++vertex) {
+            for (const auto& edge : initial_graph.OutgoingEdges(vertex)) {
+                int target_component = components[edge.GetTarget()];
+                if (components[vertex] != target_component) {
+                    edges[positions[components[vertex]]++] = graph::TargetEdge(target_component);
+                }
             }
         }
 
-        graph::Graph<graph::Edge> condence_graph(components_number, IteratorRange<
-            std::set<graph::Edge>::iterator>(edges_in_condence_graph.begin(),
-                edges_in_condence_graph.end()));
-        return condence_graph;
+        vector<int> last_sources(components_number, -1);
+        size_t unique_edges_number = 0;
+        for (int component = 0; component < components_number; ++component) {
+            size_t begin = offsets[component];
+            size_t end = offsets[component + 1];
+            offsets[component] = unique_edges_number;
+            for (size_t position = begin; position < end; ++position) {
+                int target = edges[position].GetTarget();
+                if (last_sources[target] != component) {
+                    last_sources[target] = component;
+                    edges[unique_edges_number++] = edges[position];
+                }
+            }
+        }
+        offsets[components_number] = unique_edges_number;
+        edges.resize(unique_edges_number);
+        return graph::CompressedGraph(std::move(offsets), std::move(edges));
     }
 
+    // Компоненты сильной связности при добавлении рёбер. Компоненты хранятся в системе
+    // непересекающихся множеств и поддерживаются в топологическом порядке алгоритмом
+    // Пирса-Келли: ребро, идущее вперёд по порядку, ничего не меняет, иначе поиск
+    // ограничен компонентами между его концами; если ребро замыкает цикл, компоненты
+    // на нём сливаются. Для каждой компоненты хранится число входящих рёбер из других
+    // компонент, истоки графа конденсации упорядочены по размеру.
+    // Суммарная работа поисков между пересчётами ограничена размером графа
+    // конденсации; когда она исчерпана, рёбра только запоминаются, а при следующем
+    // запросе компоненты пересчитываются на графе конденсации. Пока у какой-то вершины
+    // нет входящих рёбер, наименьший исток имеет размер 1 и рёбра тоже откладываются
+    class IncrementalComponentsBuilder {
+    public:
+        explicit IncrementalComponentsBuilder(int vertexes_number) :
+            parents(vertexes_number),
+            sizes(vertexes_number, 1),
+            incoming_edges_numbers(vertexes_number, 0),
+            orders(vertexes_number),
+            outgoing_edges(vertexes_number),
+            incoming_edges(vertexes_number),
+            roots(vertexes_number),
+            root_indexes(vertexes_number),
+            forward_stamps(vertexes_number, 0),
+            backward_stamps(vertexes_number, 0),
+            current_stamp(0),
+            search_budget(0),
+            is_outdated(true),
+            vertexes_incoming_valencies(vertexes_number, 0),
+            isolated_sources_number(vertexes_number) {
+            for (int vertex = 0; vertex < vertexes_number; ++vertex) {
+                parents[vertex] = vertex;
+                roots[vertex] = vertex;
+            }
+        }
+
+        void AddEdge(int source, int target) {
+            if (source != target && vertexes_incoming_valencies[target]++ == 0) {
+                --isolated_sources_number;
+            }
+            // пока есть вершина без входящих рёбер, наименьший исток известен
+            // и компоненты не поддерживаются
+            if (is_outdated || isolated_sources_number > 0) {
+                is_outdated = true;
+                pending_edges.emplace_back(source, target);
+                return;
+            }
+            int source_component = GetRoot(source);
+            int target_component = GetRoot(target);
+            if (source_component == target_component) {
+                return;
+            }
+            outgoing_edges[source_component].push_back(target);
+            incoming_edges[target_component].push_back(source);
+            if (incoming_edges_numbers[target_component]++ == 0) {
+                sources.erase(std::make_pair(sizes[target_component], target_component));
+            }
+            if (orders[source_component] < orders[target_component]) {
+                return;
+            }
+
+            ++current_stamp;
+            vector<int> forward_components;
+            vector<int> backward_components;
+            if (!Search(target_component, orders[source_component], true, &forward_components)
+                    || !Search(source_component, orders[target_component], false,
+                                &backward_components)) {
+                is_outdated = true;
+                return;
+            }
+
+            vector<int> free_orders;
+            for (int component : forward_components) {
+                free_orders.push_back(orders[component]);
+            }
+            for (int component : backward_components) {
+                free_orders.push_back(orders[component]);
+            }
+            std::sort(free_orders.begin(), free_orders.end());
+            free_orders.erase(std::unique(free_orders.begin(), free_orders.end()),
+                            free_orders.end());
+
+            // новый порядок, как у Пирса-Келли: достижимые только назад занимают
+            // младшие освободившиеся номера, достижимые только вперёд - старшие,
+            // слитый цикл - номер между ними, поэтому компоненты вне поисков
+            // остаются с нужной стороны от обеих частей
+            vector<int> cycle;
+            size_t position = 0;
+            for (int component : backward_components) {
+                if (forward_stamps[component] == current_stamp) {
+                    cycle.push_back(component);
+                } else {
+                    orders[component] = free_orders[position++];
+                }
+            }
+            vector<int> forward_only_components;
+            for (int component : forward_components) {
+                if (backward_stamps[component] != current_stamp) {
+                    forward_only_components.push_back(component);
+                }
+            }
+            if (!cycle.empty()) {
+                orders[MergeComponents(cycle)] = free_orders[position];
+            }
+            position = free_orders.size() - forward_only_components.size();
+            for (int component : forward_only_components) {
+                orders[component] = free_orders[position++];
+            }
+        }
+
+        // номер компоненты - одна из её вершин
+        int GetComponent(int vertex) {
+            Update();
+            return GetRoot(vertex);
+        }
+
+        int GetComponentSize(int vertex) {
+            return sizes[GetComponent(vertex)];
+        }
+
+        // размер наименьшей компоненты без входящих рёбер
+        int GetMinSourceComponentSize() {
+            if (isolated_sources_number > 0) {
+                return 1;
+            }
+            Update();
+            return sources.begin()->first;
+        }
+
+    private:
+        int GetRoot(int vertex) {
+            int root = vertex;
+            while (parents[root] != root) {
+                root = parents[root];
+            }
+            while (parents[vertex] != root) {
+                int parent = parents[vertex];
+                parents[vertex] = root;
+                vertex = parent;
+            }
+            return root;
+        }
+
+        // добавляет отложенные рёбра и пересчитывает компоненты на графе конденсации,
+        // то есть за время, линейное от числа компонент и рёбер между ними; после
+        // пересчёта в списках остаются только рёбра между компонентами без повторов
+        void Update() {
+            if (!is_outdated) {
+                return;
+            }
+            for (const auto& edge : pending_edges) {
+                outgoing_edges[GetRoot(edge.GetSource())].push_back(edge.GetTarget());
+            }
+            vector<graph::Edge>().swap(pending_edges);
+
+            roots.erase(std::remove_if(roots.begin(), roots.end(), [this](int root) {
+                return parents[root] != root;
+            }), roots.end());
+            int roots_number = static_cast<int>(roots.size());
+            for (int index = 0; index < roots_number; ++index) {
+                root_indexes[roots[index]] = index;
+            }
+            vector<graph::Edge> condence_edges;
+            for (int root : roots) {
+                for (int vertex : outgoing_edges[root]) {
+                    condence_edges.emplace_back(root_indexes[root],
+                                                root_indexes[GetRoot(vertex)]);
+                }
+                vector<int>().swap(outgoing_edges[root]);
+                vector<int>().swap(incoming_edges[root]);
+            }
+            graph::CompressedGraph roots_graph(roots_number,
+                IteratorRange<vector<graph::Edge>::const_iterator>(condence_edges.begin(),
+                                                                    condence_edges.end()));
+            vector<graph::Edge>().swap(condence_edges);
+            vector<int> components = FindStronglyConnectedComponents(roots_graph);
+            graph::CompressedGraph components_graph = CondenceGraph(components, roots_graph);
+
+            vector<int> new_roots(components_graph.VertexesNumber(), -1);
+            for (int index = 0; index < roots_number; ++index) {
+                int root = roots[index];
+                int& new_root = new_roots[components[index]];
+                if (new_root == -1) {
+                    new_root = root;
+                    continue;
+                }
+                parents[root] = new_root;
+                sizes[new_root] += sizes[root];
+            }
+            roots.swap(new_roots);
+
+            int components_number = static_cast<int>(roots.size());
+            for (int component = 0; component < components_number; ++component) {
+                for (const auto& edge : components_graph.OutgoingEdges(component)) {
+                    outgoing_edges[roots[component]].push_back(roots[edge.GetTarget()]);
+                    incoming_edges[roots[edge.GetTarget()]].push_back(roots[component]);
+                }
+            }
+            sources.clear();
+            for (int component = 0; component < components_number; ++component) {
+                int root = roots[component];
+                orders[root] = component;
+                incoming_edges_numbers[root] = incoming_edges[root].size();
+                if (incoming_edges_numbers[root] == 0) {
+                    sources.insert(std::make_pair(sizes[root], root));
+                }
+            }
+            search_budget = components_number + 2 * components_graph.EdgesNumber();
+            is_outdated = false;
+        }
+
+        // обход компонент, порядок которых не дальше bound_order; компоненты
+        // выписываются в порядке возрастания; возвращает false, если исчерпан
+        // запас работы до перестроения
+        bool Search(int origin, int bound_order, bool forward, vector<int>* components) {
+            vector<uint64_t>& stamps = forward ? forward_stamps : backward_stamps;
+            vector<int> stack(1, origin);
+            stamps[origin] = current_stamp;
+            while (!stack.empty()) {
+                int component = stack.back();
+                stack.pop_back();
+                components->push_back(component);
+                // соседи другого конца ребра лежат за границей порядка
+                if (orders[component] == bound_order) {
+                    continue;
+                }
+                const vector<int>& component_edges = forward ? outgoing_edges[component]
+                                                                : incoming_edges[component];
+                if (component_edges.size() + 1 > search_budget) {
+                    return false;
+                }
+                search_budget -= component_edges.size() + 1;
+                for (int vertex : component_edges) {
+                    int neighbour = GetRoot(vertex);
+                    if (stamps[neighbour] != current_stamp
+                            && (forward ? orders[neighbour] <= bound_order
+                                        : orders[neighbour] >= bound_order)) {
+                        stamps[neighbour] = current_stamp;
+                        stack.push_back(neighbour);
+                    }
+                }
+            }
+            std::sort(components->begin(), components->end(), [this](int first, int second) {
+                return orders[first] < orders[second];
+            });
+            return true;
+        }
+
+        // компоненты цикла отмечены в обоих поисках; к компоненте с самыми длинными
+        // списками рёбер присоединяются остальные, рёбра внутри цикла вычитаются из
+        // числа входящих рёбер, поэтому работа пропорциональна присоединяемым спискам
+        int MergeComponents(const vector<int>& cycle) {
+            int largest = cycle.front();
+            for (int component : cycle) {
+                if (outgoing_edges[component].size() + incoming_edges[component].size()
+                    > outgoing_edges[largest].size() + incoming_edges[largest].size()) {
+                    largest = component;
+                }
+            }
+
+            size_t incoming_edges_number = 0;
+            size_t inner_edges_number = 0;
+            for (int component : cycle) {
+                incoming_edges_number += incoming_edges_numbers[component];
+                if (incoming_edges_numbers[component] == 0) {
+                    sources.erase(std::make_pair(sizes[component], component));
+                }
+                if (component == largest) {
+                    continue;
+                }
+                for (int vertex : incoming_edges[component]) {
+                    int neighbour = GetRoot(vertex);
+                    if (neighbour != component && InCycle(neighbour)) {
+                        ++inner_edges_number;
+                    }
+                }
+                for (int vertex : outgoing_edges[component]) {
+                    if (GetRoot(vertex) == largest) {
+                        ++inner_edges_number;
+                    }
+                }
+            }
+
+            for (int component : cycle) {
+                if (component == largest) {
+                    continue;
+                }
+                parents[component] = largest;
+                sizes[largest] += sizes[component];
+                AppendEdges(&outgoing_edges[component], &outgoing_edges[largest]);
+                AppendEdges(&incoming_edges[component], &incoming_edges[largest]);
+            }
+            incoming_edges_numbers[largest] = incoming_edges_number - inner_edges_number;
+            if (incoming_edges_numbers[largest] == 0) {
+                sources.insert(std::make_pair(sizes[largest], largest));
+            }
+            return largest;
+        }
+
+        bool InCycle(int component) const {
+            return forward_stamps[component] == current_stamp
+                && backward_stamps[component] == current_stamp;
+        }
+
+        static void AppendEdges(vector<int>* from, vector<int>* to) {
+            to->insert(to->end(), from->begin(), from->end());
+            vector<int>().swap(*from);
+        }
+
+        vector<graph::Edge> pending_edges;
+        vector<int> parents;
+        vector<int> sizes;
+        vector<size_t> incoming_edges_numbers;
+        vector<int> orders;
+        // вершины на других концах рёбер компоненты, включая ставшие внутренними
+        // после последнего пересчёта
+        vector<vector<int>> outgoing_edges;
+        vector<vector<int>> incoming_edges;
+        // корни компонент на момент последнего пересчёта
+        vector<int> roots;
+        vector<int> root_indexes;
+        // метки посещения при поиске от ребра; 64-битный счётчик
+        // растёт с каждым обратным ребром и не переполняется
+        vector<uint64_t> forward_stamps;
+        vector<uint64_t> backward_stamps;
+        uint64_t current_stamp;
+        size_t search_budget;
+        bool is_outdated;
+        std::set<std::pair<int, int>> sources;
+        // входящие рёбра вершин без петель; вершина без них - отдельная компонента-исток
+        vector<size_t> vertexes_incoming_valencies;
+        int isolated_sources_number;
+    };
+
 } // namespace components_builder
 
 namespace incoming_valency_builder {
@@ -302,13 +1077,51 @@ namespace incoming_valency_builder {
         IncomingValencyBuilder incoming_valency_builder(graph.VertexesNumber());
         IncomingValencyBuilderVisitor<IncomingValencyBuilder>
             incoming_valency_builder_visitor(&incoming_valency_builder);
-        traverses::DepthFirstSearchGraph(incoming_valency_builder_visitor,
-                                        graph,
-                                        boost::counting_iterator<int>(0),
-                                        boost::counting_iterator<int>(graph.VertexesNumber()));
+        traverses::ScanEdges(incoming_valency_builder_visitor, graph);
         return incoming_valency_builder.GetIncomingValencies();
     }
 
+    // histogram of targets in one pass over the edge array
+    inline vector<size_t> FindIncomingValencies(const graph::CompressedGraph& graph) {
+        vector<size_t> incoming_valencies(graph.VertexesNumber(), 0);
+        for (const auto& edge : graph.Edges()) {
+            ++incoming_valencies[edge.GetTarget()];
+        }
+        return incoming_valencies;
+    }
+
+    // every thread counts its part of the edge array into its own histogram,
+    // then the histograms are summed by ranges of vertexes
+    inline vector<size_t> FindIncomingValenciesInParallel(const graph::CompressedGraph& graph,
+                                                        int threads_number) {
+        threads_number = std::max(threads_number, 1);
+        size_t vertexes_number = graph.VertexesNumber();
+        auto edges = graph.Edges();
+        size_t edges_number = graph.EdgesNumber();
+        vector<vector<size_t>> histograms(threads_number);
+        vector<size_t> incoming_valencies(vertexes_number, 0);
+
+        RunInParallel(threads_number, [&](int thread_index) {
+            vector<size_t>& histogram = histograms[thread_index];
+            histogram.assign(vertexes_number, 0);
+            auto end = edges.begin() + edges_number * (thread_index + 1) / threads_number;
+            for (auto edge = edges.begin() + edges_number * thread_index / threads_number;
+                    edge != end; ++edge) {
+                ++histogram[edge->GetTarget()];
+            }
+        });
+        RunInParallel(threads_number, [&](int thread_index) {
+            size_t end = vertexes_number * (thread_index + 1) / threads_number;
+            for (const auto& histogram : histograms) {
+                for (size_t vertex = vertexes_number * thread_index / threads_number;
+                        vertex < end; ++vertex) {
+                    incoming_valencies[vertex] += histogram[vertex];
+                }
+            }
+        });
+        return incoming_valencies;
+    }
+
 } // namespace incoming_valency_builder
 
 struct GameResult {
@@ -330,28 +1143,27 @@ struct GameResult {
     Outcome outcome;
 };
 
-graph::Graph<graph::Edge> MakeRelationshipsGraph(const vector<GameResult>& games_results,
-                                                int candidates_number) {
-    graph::Graph<graph::Edge> relationships_graph(candidates_number);
+graph::CompressedGraph MakeRelationshipsGraph(const vector<GameResult>& games_results,
+                                            int candidates_number) {
+    vector<graph::Edge> edges;
+    edges.reserve(games_results.size());
     for (const auto& game_result : games_results) {
         GameResult::Outcome outcome = game_result.outcome;
         if (outcome == GameResult::Outcome::WIN) {
-            relationships_graph.AddEdge(graph::Edge(game_result.first_candidate,
-                                                    game_result.second_candidate));
+            edges.emplace_back(game_result.first_candidate, game_result.second_candidate);
         } else if (outcome == GameResult::Outcome::LOSS) {
-            relationships_graph.AddEdge(graph::Edge(game_result.second_candidate,
-                                                    game_result.first_candidate));
+            edges.emplace_back(game_result.second_candidate, game_result.first_candidate);
         }
     }
-    return relationships_graph;
+    return graph::CompressedGraph(candidates_number,
+        IteratorRange<vector<graph::Edge>::const_iterator>(edges.begin(), edges.end()));
 }
 
-int FindMaxCompanySize(int candidates_number, const vector<GameResult>& games_results) {
-    graph::Graph<graph::Edge> relationshipsGraph = MakeRelationshipsGraph(games_results,
-                                                                            candidates_number);
+int FindMaxCompanySize(const graph::CompressedGraph& relationshipsGraph) {
+    int candidates_number = static_cast<int>(relationshipsGraph.VertexesNumber());
     vector<int> components;
     components = components_builder::FindStronglyConnectedComponents(relationshipsGraph);
-    graph::Graph<graph::Edge> condece_graph;
+    graph::CompressedGraph condece_graph;
     condece_graph = components_builder::CondenceGraph(components, relationshipsGraph);
 
     vector<size_t> vertexes_incoming_valency_of_condence_graph
@@ -372,6 +1184,37 @@ int FindMaxCompanySize(int candidates_number, const vector<GameResult>& games_re
     return candidates_number - min_root_component_size + 1;
 }
 
+int FindMaxCompanySize(int candidates_number, const vector<GameResult>& games_results) {
+    return FindMaxCompanySize(MakeRelationshipsGraph(games_results, candidates_number));
+}
+
+// Ответ FindMaxCompanySize для растущего списка результатов игр
+class IncrementalCompanySizeFinder {
+public:
+    explicit IncrementalCompanySizeFinder(int candidates_number) :
+        candidates_number(candidates_number),
+        components_builder(candidates_number) {
+    }
+
+    void AddGameResult(const GameResult& game_result) {
+        if (game_result.outcome == GameResult::Outcome::WIN) {
+            components_builder.AddEdge(game_result.first_candidate,
+                                        game_result.second_candidate);
+        } else if (game_result.outcome == GameResult::Outcome::LOSS) {
+            components_builder.AddEdge(game_result.second_candidate,
+                                        game_result.first_candidate);
+        }
+    }
+
+    int GetMaxCompanySize() {
+        return candidates_number - components_builder.GetMinSourceComponentSize() + 1;
+    }
+
+private:
+    int candidates_number;
+    components_builder::IncrementalComponentsBuilder components_builder;
+};
+
 vector<GameResult> ReadGamesResults() {
     int games_number;
     std::cin >> games_number;
@@ -399,7 +1242,222 @@ vector<GameResult> ReadGamesResults() {
     return games_results;
 }
 
-int main() {
+// Reads integers from a stream block by block, either as whitespace separated
+// text or as native 32-bit values
+class IntegersReader {
+public:
+    enum Format {
+        TEXT,
+        BINARY
+    };
+
+    IntegersReader(std::istream* input, Format format, size_t block_size = 1 << 20) :
+        input(input), format(format), buffer(block_size), position(0), size(0) {
+    }
+
+    bool Read(int* value) {
+        if (format == BINARY) {
+            int32_t binary_value;
+            if (size - position >= sizeof(binary_value)) {
+                std::memcpy(&binary_value, buffer.data() + position, sizeof(binary_value));
+                position += sizeof(binary_value);
+                *value = binary_value;
+                return true;
+            }
+            char* bytes = reinterpret_cast<char*>(&binary_value);
+            for (size_t i = 0; i < sizeof(binary_value); ++i) {
+                if (!NextByte(bytes + i)) {
+                    return false;
+                }
+            }
+            *value = binary_value;
+            return true;
+        }
+
+        char byte;
+        do {
+            if (!NextByte(&byte)) {
+                return false;
+            }
+        } while (std::isspace(static_cast<unsigned char>(byte)));
+        bool is_negative = byte == '-';
+        if (is_negative && !NextByte(&byte)) {
+            return false;
+        }
+        // the magnitude of the smallest int is larger by one
+        const long long limit = static_cast<long long>(std::numeric_limits<int>::max())
+            + (is_negative ? 1 : 0);
+        long long result = 0;
+        bool has_digits = false;
+        bool has_next_byte = true;
+        while (byte >= '0' && byte <= '9') {
+            result = result * 10 + (byte - '0');
+            has_digits = true;
+            if (result > limit) {
+                throw std::runtime_error("Integer doesn't fit into int");
+            }
+            if (!NextByte(&byte)) {
+                has_next_byte = false;
+                break;
+            }
+        }
+        if (!has_digits) {
+            throw std::runtime_error("Integer expected");
+        }
+        if (has_next_byte && !std::isspace(static_cast<unsigned char>(byte))) {
+            throw std::runtime_error("Unexpected character after integer");
+        }
+        *value = static_cast<int>(is_negative ? -result : result);
+        return true;
+    }
+
+private:
+    bool NextByte(char* byte) {
+        if (position == size) {
+            input->read(buffer.data(), buffer.size());
+            size = static_cast<size_t>(input->gcount());
+            position = 0;
+            if (size == 0) {
+                return false;
+            }
+        }
+        *byte = buffer[position++];
+        return true;
+    }
+
+    std::istream* input;
+    Format format;
+    vector<char> buffer;
+    size_t position;
+    size_t size;
+};
+
+// Reads input of ReadGamesResults preceded by the candidates number
+// game by game without storing games
+class GamesResultsReader {
+public:
+    GamesResultsReader(std::istream* input, IntegersReader::Format format) :
+        integers_reader(input, format), games_number(0), read_games_number(0) {
+        if (!integers_reader.Read(&candidates_number)
+                || !integers_reader.Read(&games_number)) {
+            throw std::runtime_error("Candidates and games numbers expected");
+        }
+        if (candidates_number <= 0 || games_number < 0) {
+            throw std::runtime_error("Wrong candidates or games number");
+        }
+    }
+
+    int GetCandidatesNumber() const {
+        return candidates_number;
+    }
+
+    // candidates are numbered from 0; returns false after the last game
+    bool Read(int* first_candidate, int* second_candidate, GameResult::Outcome* outcome) {
+        if (read_games_number == games_number) {
+            return false;
+        }
+        int outcome_number;
+        if (!integers_reader.Read(first_candidate)
+                || !integers_reader.Read(second_candidate)
+                || !integers_reader.Read(&outcome_number)) {
+            throw std::runtime_error("Input ends after " + std::to_string(read_games_number)
+                                    + " of " + std::to_string(games_number) + " games");
+        }
+        if (*first_candidate < 1 || *first_candidate > candidates_number
+                || *second_candidate < 1 || *second_candidate > candidates_number) {
+            throw std::runtime_error("Wrong candidate in game "
+                                    + std::to_string(read_games_number + 1));
+        }
+        --*first_candidate;
+        --*second_candidate;
+        if (outcome_number == 1) {
+            *outcome = GameResult::Outcome::WIN;
+        } else if (outcome_number == 2) {
+            *outcome = GameResult::Outcome::LOSS;
+        } else {
+            *outcome = GameResult::Outcome::DRAW;
+        }
+        ++read_games_number;
+        return true;
+    }
+
+private:
+    IntegersReader integers_reader;
+    int candidates_number;
+    int games_number;
+    int read_games_number;
+};
+
+// Calls on_edges(edges) for consecutive batches of edges made of WINs and LOSSes
+// of the file; batches keep parsing apart from random writes into the graph
+template <class Callback>
+void ForEachRelationshipsBatch(const std::string& path, IntegersReader::Format format,
+                                Callback on_edges) {
+    const size_t kBatchSize = 1 << 16;
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Can't open " + path);
+    }
+    GamesResultsReader reader(&input, format);
+    vector<graph::Edge> edges;
+    edges.reserve(kBatchSize);
+    int first_candidate;
+    int second_candidate;
+    GameResult::Outcome outcome;
+    while (reader.Read(&first_candidate, &second_candidate, &outcome)) {
+        if (outcome == GameResult::Outcome::WIN) {
+            edges.emplace_back(first_candidate, second_candidate);
+        } else if (outcome == GameResult::Outcome::LOSS) {
+            edges.emplace_back(second_candidate, first_candidate);
+        }
+        if (edges.size() == kBatchSize) {
+            on_edges(edges);
+            edges.clear();
+        }
+    }
+    on_edges(edges);
+}
+
+// Reads the file twice, counting edges of every candidate and then filling them
+// into the graph, so neither games nor all edges are kept in memory
+graph::CompressedGraph LoadRelationshipsGraph(const std::string& path,
+                                            IntegersReader::Format format) {
+    int candidates_number;
+    {
+        std::ifstream input(path, std::ios::binary);
+        if (!input) {
+            throw std::runtime_error("Can't open " + path);
+        }
+        candidates_number = GamesResultsReader(&input, format).GetCandidatesNumber();
+    }
+    graph::CompressedGraphBuilder builder(candidates_number);
+    ForEachRelationshipsBatch(path, format, [&builder](const vector<graph::Edge>& edges) {
+        for (const auto& edge : edges) {
+            builder.CountEdge(edge.GetSource());
+        }
+    });
+    builder.StartFilling();
+    ForEachRelationshipsBatch(path, format, [&builder](const vector<graph::Edge>& edges) {
+        for (const auto& edge : edges) {
+            builder.AddEdge(edge.GetSource(), edge.GetTarget());
+        }
+    });
+    return builder.Build();
+}
+
+// With a file argument reads games from it, in binary form if --binary follows
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        IntegersReader::Format format = argc > 2 && std::string(argv[2]) == "--binary"
+            ? IntegersReader::Format::BINARY : IntegersReader::Format::TEXT;
+        try {
+            std::cout << FindMaxCompanySize(LoadRelationshipsGraph(argv[1], format)) << std::endl;
+        } catch (const std::exception& error) {
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
     int candidates_number;
     std::cin >> candidates_number;
     vector<GameResult> games_results = ReadGamesResults();
@@ -1,10 +1,11 @@
 #include <iostream>
 #include <vector>
 #include <random>
-#include <limits>
 #include <utility>
 #include <algorithm>
 #include <string>
+#include <chrono>
+#include <type_traits>
 
 const long long primeNumber = 2147483053;
 
@@ -36,31 +37,78 @@ private:
     long long module_;
 };
 
+unsigned long long randomSeed()
+{
+    std::random_device randomDevice;
+    return (static_cast<unsigned long long>(randomDevice()) << 32) | randomDevice();
+}
+
+// SplitMix64: the i-th number is a bijective mix of seed + i * gamma, so the
+// generator is a plain counter and every build is reproducible from its seed
+class CounterRandomGenerator
+{
+public:
+    explicit CounterRandomGenerator(unsigned long long seed) : seed_(seed), counter_(0) {}
+    unsigned long long operator()()
+    {
+        unsigned long long result = seed_ + (++counter_) * 0x9E3779B97F4A7C15ULL;
+        result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        result = (result ^ (result >> 27)) * 0x94D049BB133111EBULL;
+        return result ^ (result >> 31);
+    }
+    // returns number from [from, to]
+    long long uniform(long long from, long long to)
+    {
+        unsigned long long range = static_cast<unsigned long long>(to - from) + 1;
+        return from + static_cast<long long>((*this)() % range);
+    }
+
+private:
+    unsigned long long seed_;
+    unsigned long long counter_;
+};
+
+HashFunction randomHashFunction(CounterRandomGenerator& generator, long long module)
+{
+    long long linearCoefficient = generator.uniform(1, primeNumber - 1);
+    long long constant = generator.uniform(0, primeNumber - 1);
+    return HashFunction(linearCoefficient, constant, module);
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
 class NoCollisionsQuadraticMemoryHashTable
 {
 public:
     NoCollisionsQuadraticMemoryHashTable() {}
-    void initialize(const std::vector<int>& data)
+    // reserves reservedSize^2 slots, so that up to reservedSize elements
+    // can be inserted later mostly without collisions;
+    // returns number of rejected hash functions
+    size_t initialize(const std::vector<int>& data, size_t reservedSize,
+            CounterRandomGenerator& generator)
     {
-        if (data.empty()) {
-            return;
+        reservedSize = std::max(reservedSize, data.size());
+        if (reservedSize == 0) {
+            elements_.clear();
+            occupied_.clear();
+            return 0;
         }
-        std::random_device randomDevice;
-        std::mt19937 generator(randomDevice());
-        std::uniform_int_distribution<long long> firstDistribution(1, primeNumber);
-        std::uniform_int_distribution<long long> secondDistribution(0, primeNumber);
-        long long size = static_cast<long long>(data.size() * data.size());
+        long long size = static_cast<long long>(reservedSize * reservedSize);
         elements_.resize(size);
+        size_t retries = 0;
         bool stop = false;
         while (!stop) {
-            hashFunction_ = HashFunction(firstDistribution(generator),
-                secondDistribution(generator), size);
-            std::fill(elements_.begin(), elements_.end(), std::numeric_limits<int>::max());
+            hashFunction_ = randomHashFunction(generator, size);
+            occupied_.assign(size, false);
             bool again = false;
             for (size_t i = 0; i < data.size(); ++i) {
                 long long index = hashFunction_(data[i]);
-                if (elements_[index] == std::numeric_limits<int>::max()) {
+                if (!occupied_[index]) {
                     elements_[index] = data[i];
+                    occupied_[index] = true;
                 } else {
                     again = true;
                     break;
@@ -68,38 +116,355 @@ public:
             }
             if (!again) {
                 stop = true;
+            } else {
+                ++retries;
             }
         }
+        return retries;
+    }
+    // returns index of the slot holding element or -1 if there is no such element
+    long long find(int element) const
+    {
+        if (elements_.empty()) {
+            return -1;
+        }
+        long long index = hashFunction_(element);
+        if (!occupied_[index] || elements_[index] != element) {
+            return -1;
+        }
+        return index;
     }
     bool contains(int element) const
+    {
+        return find(element) != -1;
+    }
+    // returns false if the slot of element is occupied by another element
+    bool insert(int element)
     {
         if (elements_.empty()) {
             return false;
         }
-        return elements_[hashFunction_(element)] == element;
+        long long index = hashFunction_(element);
+        if (occupied_[index] && elements_[index] != element) {
+            return false;
+        }
+        elements_[index] = element;
+        occupied_[index] = true;
+        return true;
+    }
+    void erase(int element)
+    {
+        long long index = find(element);
+        if (index != -1) {
+            occupied_[index] = false;
+        }
+    }
+    size_t capacity() const
+    {
+        return elements_.size();
+    }
+    std::vector<int> elements() const
+    {
+        std::vector<int> result;
+        for (size_t i = 0; i < elements_.size(); ++i) {
+            if (occupied_[i]) {
+                result.push_back(elements_[i]);
+            }
+        }
+        return result;
     }
 
 private:
     std::vector<int> elements_;
+    // any int can be an element, so empty slots are marked separately
+    std::vector<bool> occupied_;
     HashFunction hashFunction_;
 };
 
+// Minimal perfect hash table in the spirit of BBHash. Keys are hashed into a bit array
+// of the size of the remaining keys; keys that do not collide with others are fixed
+// at this level, the rest go to the next level with another hash function. The slot
+// of a key is the rank of its bit among all set bits, so exactly data.size() slots are
+// used and the hash itself takes about 3 bits per key. Keys are kept to verify hits.
+class MinimalPerfectHashTable
+{
+public:
+    MinimalPerfectHashTable() : placedNumber_(0) {}
+    void initialize(const std::vector<int>& data, CounterRandomGenerator& generator)
+    {
+        levelHashFunctions_.clear();
+        levelOffsets_.clear();
+        bits_.clear();
+        std::vector<int> remaining = data;
+        // bit position and element of every key fixed at some level
+        std::vector<std::pair<size_t, int>> placed;
+        size_t offset = 0;
+        while (!remaining.empty() && levelHashFunctions_.size() < maxLevelsNumber) {
+            size_t wordsNumber = (remaining.size() + bitsInWord - 1) / bitsInWord;
+            size_t levelSize = wordsNumber * bitsInWord;
+            HashFunction hashFunction = randomHashFunction(generator,
+                static_cast<long long>(levelSize));
+            std::vector<unsigned long long> seen(wordsNumber, 0);
+            std::vector<unsigned long long> collided(wordsNumber, 0);
+            for (int element : remaining) {
+                size_t position = static_cast<size_t>(hashFunction(element));
+                unsigned long long mask = 1ULL << (position % bitsInWord);
+                if (seen[position / bitsInWord] & mask) {
+                    collided[position / bitsInWord] |= mask;
+                } else {
+                    seen[position / bitsInWord] |= mask;
+                }
+            }
+            std::vector<int> next;
+            for (int element : remaining) {
+                size_t position = static_cast<size_t>(hashFunction(element));
+                if (collided[position / bitsInWord] & (1ULL << (position % bitsInWord))) {
+                    next.push_back(element);
+                } else {
+                    placed.push_back(std::make_pair(offset + position, element));
+                }
+            }
+            for (size_t i = 0; i < wordsNumber; ++i) {
+                bits_.push_back(seen[i] & ~collided[i]);
+            }
+            levelHashFunctions_.push_back(hashFunction);
+            levelOffsets_.push_back(offset);
+            offset += levelSize;
+            remaining.swap(next);
+        }
+        blockRanks_.clear();
+        size_t setBitsNumber = 0;
+        for (size_t i = 0; i < bits_.size(); ++i) {
+            if (i % wordsInRankBlock == 0) {
+                blockRanks_.push_back(setBitsNumber);
+            }
+            setBitsNumber += __builtin_popcountll(bits_[i]);
+        }
+        placedNumber_ = placed.size();
+        keys_.resize(placedNumber_);
+        for (const auto& positionAndElement : placed) {
+            keys_[rank(positionAndElement.first)] = positionAndElement.second;
+        }
+        // keys that were not separated by any level are searched for in sorted order
+        std::sort(remaining.begin(), remaining.end());
+        keys_.insert(keys_.end(), remaining.begin(), remaining.end());
+    }
+    // returns index of the slot holding element or -1 if there is no such element
+    long long find(int element) const
+    {
+        for (size_t level = 0; level < levelHashFunctions_.size(); ++level) {
+            size_t position = levelOffsets_[level]
+                + static_cast<size_t>(levelHashFunctions_[level](element));
+            if (bits_[position / bitsInWord] & (1ULL << (position % bitsInWord))) {
+                size_t index = rank(position);
+                if (keys_[index] != element) {
+                    return -1;
+                }
+                return static_cast<long long>(index);
+            }
+        }
+        auto fallback = std::lower_bound(keys_.begin() + placedNumber_, keys_.end(), element);
+        if (fallback == keys_.end() || *fallback != element) {
+            return -1;
+        }
+        return fallback - keys_.begin();
+    }
+    bool contains(int element) const
+    {
+        return find(element) != -1;
+    }
+    size_t capacity() const
+    {
+        return keys_.size();
+    }
+    size_t levelsNumber() const
+    {
+        return levelHashFunctions_.size();
+    }
+
+private:
+    static const size_t bitsInWord = 64;
+    static const size_t wordsInRankBlock = 8;
+    static const size_t maxLevelsNumber = 32;
+
+    // returns number of set bits before position
+    size_t rank(size_t position) const
+    {
+        size_t word = position / bitsInWord;
+        size_t result = blockRanks_[word / wordsInRankBlock];
+        for (size_t i = word - word % wordsInRankBlock; i < word; ++i) {
+            result += __builtin_popcountll(bits_[i]);
+        }
+        unsigned long long lowerBits = (1ULL << (position % bitsInWord)) - 1;
+        return result + __builtin_popcountll(bits_[word] & lowerBits);
+    }
+
+    std::vector<HashFunction> levelHashFunctions_;
+    std::vector<size_t> levelOffsets_;
+    std::vector<unsigned long long> bits_;
+    // number of set bits before every block of wordsInRankBlock words
+    std::vector<unsigned int> blockRanks_;
+    size_t placedNumber_;
+    // keys in rank order followed by sorted keys which were not placed at any level
+    std::vector<int> keys_;
+};
+
+// Blocked Bloom filter: every element sets bitsPerElement bits inside one block of
+// the size of a cache line, so a negative answer costs a single memory access
+class BlockedBloomFilter
+{
+public:
+    BlockedBloomFilter() {}
+    void initialize(const std::vector<int>& data, CounterRandomGenerator& generator)
+    {
+        size_t blocksNumber = (data.size() * bitsPerKey + bitsInBlock - 1) / bitsInBlock;
+        if (blocksNumber == 0) {
+            blocksNumber = 1;
+        }
+        blockHashFunction_ = randomHashFunction(generator, static_cast<long long>(blocksNumber));
+        bitsHashFunction_ = randomHashFunction(generator, primeNumber);
+        words_.assign(blocksNumber * wordsInBlock, 0);
+        for (int element : data) {
+            unsigned long long* block = &words_[blockHashFunction_(element) * wordsInBlock];
+            long long bits = bitsHashFunction_(element);
+            for (size_t i = 0; i < bitsPerElement; ++i, bits >>= bitsInBlockIndex) {
+                size_t bit = static_cast<size_t>(bits) % bitsInBlock;
+                block[bit / bitsInWord] |= 1ULL << (bit % bitsInWord);
+            }
+        }
+    }
+    // false means that element surely was not in data
+    bool mayContain(int element) const
+    {
+        if (words_.empty()) {
+            return false;
+        }
+        const unsigned long long* block = &words_[blockHashFunction_(element) * wordsInBlock];
+        long long bits = bitsHashFunction_(element);
+        for (size_t i = 0; i < bitsPerElement; ++i, bits >>= bitsInBlockIndex) {
+            size_t bit = static_cast<size_t>(bits) % bitsInBlock;
+            if (!(block[bit / bitsInWord] & (1ULL << (bit % bitsInWord)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    static const size_t bitsInWord = 64;
+    static const size_t wordsInBlock = 8;
+    static const size_t bitsInBlock = bitsInWord * wordsInBlock;
+    static const size_t bitsInBlockIndex = 9;
+    // 3 indexes of 9 bits are taken from the 31-bit value of bitsHashFunction_
+    static const size_t bitsPerElement = 3;
+    static const size_t bitsPerKey = 8;
+
+    HashFunction blockHashFunction_;
+    HashFunction bitsHashFunction_;
+    std::vector<unsigned long long> words_;
+};
+
+enum class FixedSetMode
+{
+    FKS,
+    MINIMAL_PERFECT_HASH
+};
+
+struct FixedSetBuildReport
+{
+    FixedSetBuildReport() :
+        seed(0), outerRetries(0), bucketRetries(0), maxBucketRetries(0), maxBucketSize(0),
+        levelsNumber(0), prefilterSeconds(0), topLevelSeconds(0), bucketsSeconds(0) {}
+
+    unsigned long long seed;
+    // rejected top level hash functions
+    size_t outerRetries;
+    // rejected hash functions summed over all buckets and the maximum over a bucket
+    size_t bucketRetries;
+    size_t maxBucketRetries;
+    size_t maxBucketSize;
+    // levels of the minimal perfect hash
+    size_t levelsNumber;
+    double prefilterSeconds;
+    // distribution of elements into buckets or levels of the minimal perfect hash
+    double topLevelSeconds;
+    double bucketsSeconds;
+};
+
 class FixedSet
 {
 public:
-    FixedSet() {}
-    void initialize(const std::vector<int>& data)
+    FixedSet() : mode_(FixedSetMode::FKS), usePrefilter_(false), capacity_(0) {}
+    // usePrefilter builds a Bloom filter which is checked before the hash tables,
+    // it pays off when most of the requests are misses;
+    // the same data and seed always produce the same set
+    void initialize(const std::vector<int>& data, FixedSetMode mode = FixedSetMode::FKS,
+            bool usePrefilter = false, unsigned long long seed = randomSeed())
+    {
+        mode_ = mode;
+        usePrefilter_ = usePrefilter;
+        buildReport_ = FixedSetBuildReport();
+        buildReport_.seed = seed;
+        CounterRandomGenerator generator(seed);
+        if (usePrefilter_) {
+            auto start = std::chrono::steady_clock::now();
+            prefilter_.initialize(data, generator);
+            buildReport_.prefilterSeconds = secondsSince(start);
+        }
+        if (mode_ == FixedSetMode::MINIMAL_PERFECT_HASH) {
+            hashTables_.clear();
+            offsets_.clear();
+            auto start = std::chrono::steady_clock::now();
+            minimalPerfectHashTable_.initialize(data, generator);
+            buildReport_.topLevelSeconds = secondsSince(start);
+            buildReport_.levelsNumber = minimalPerfectHashTable_.levelsNumber();
+            capacity_ = minimalPerfectHashTable_.capacity();
+            return;
+        }
+        initializeBuckets(data, generator);
+    }
+    // returns index of the slot holding element among all capacity() slots
+    // of the set or -1 if there is no such element
+    long long find(int element) const
+    {
+        if (usePrefilter_ && !prefilter_.mayContain(element)) {
+            return -1;
+        }
+        if (mode_ == FixedSetMode::MINIMAL_PERFECT_HASH) {
+            return minimalPerfectHashTable_.find(element);
+        }
+        if (hashTables_.empty()) {
+            return -1;
+        }
+        long long index = hashFunction_(element);
+        long long slot = hashTables_[index].find(element);
+        if (slot == -1) {
+            return -1;
+        }
+        return offsets_[index] + slot;
+    }
+    bool contains(int element) const
+    {
+        return find(element) != -1;
+    }
+    size_t capacity() const
     {
+        return capacity_;
+    }
+    const FixedSetBuildReport& buildReport() const
+    {
+        return buildReport_;
+    }
+
+private:
+    void initializeBuckets(const std::vector<int>& data, CounterRandomGenerator& generator)
+    {
+        auto start = std::chrono::steady_clock::now();
         std::vector<std::vector<int>> numbers(data.size());
-        std::random_device randomDevice;
-        std::mt19937 generator(randomDevice());
-        std::uniform_int_distribution<long long> firstDistribution(1, primeNumber - 1);
-        std::uniform_int_distribution<long long> secondDistribution(0, primeNumber - 1);
         long long size = static_cast<long long>(data.size());
         bool stop = false;
         while (!stop) {
-            hashFunction_ = HashFunction(firstDistribution(generator),
-                secondDistribution(generator), size);
+            hashFunction_ = randomHashFunction(generator, size);
             for (size_t i = 0; i < numbers.size(); ++i) {
                 numbers[i].resize(0);
             }
@@ -114,27 +479,220 @@ public:
             }
             if (sumOfSquaresOfLength < 3 * static_cast<long long>(numbers.size())) {
                 stop = true;
+            } else {
+                ++buildReport_.outerRetries;
             }
         }
+        buildReport_.topLevelSeconds = secondsSince(start);
+        start = std::chrono::steady_clock::now();
+        hashTables_.clear();
+        offsets_.clear();
+        long long offset = 0;
         for (size_t i = 0; i < numbers.size(); ++i) {
             hashTables_.push_back(NoCollisionsQuadraticMemoryHashTable());
-            hashTables_[i].initialize(numbers[i]);
+            size_t retries = hashTables_[i].initialize(numbers[i], numbers[i].size(), generator);
+            buildReport_.bucketRetries += retries;
+            buildReport_.maxBucketRetries = std::max(buildReport_.maxBucketRetries, retries);
+            buildReport_.maxBucketSize = std::max(buildReport_.maxBucketSize, numbers[i].size());
+            offsets_.push_back(offset);
+            offset += static_cast<long long>(hashTables_[i].capacity());
         }
+        capacity_ = static_cast<size_t>(offset);
+        buildReport_.bucketsSeconds = secondsSince(start);
+    }
+
+    FixedSetMode mode_;
+    bool usePrefilter_;
+    BlockedBloomFilter prefilter_;
+    HashFunction hashFunction_;
+    std::vector<NoCollisionsQuadraticMemoryHashTable> hashTables_;
+    std::vector<long long> offsets_;
+    MinimalPerfectHashTable minimalPerfectHashTable_;
+    size_t capacity_;
+    FixedSetBuildReport buildReport_;
+};
+
+// Key must be an integral type whose values fit into int. Value can't be bool:
+// find() returns a pointer into values_, and std::vector<bool> has no such pointers
+template <class Key, class Value>
+class FixedMap
+{
+    static_assert(std::is_integral<Key>::value && sizeof(Key) <= sizeof(int),
+        "FixedMap keys are stored in a FixedSet of int");
+    static_assert(!std::is_same<Value, bool>::value,
+        "FixedMap can't return pointers into std::vector<bool>, use char values");
+
+public:
+    FixedMap() {}
+    void initialize(const std::vector<std::pair<Key, Value>>& data,
+            FixedSetMode mode = FixedSetMode::FKS, unsigned long long seed = randomSeed())
+    {
+        std::vector<int> keys;
+        keys.reserve(data.size());
+        for (const auto& keyAndValue : data) {
+            keys.push_back(static_cast<int>(keyAndValue.first));
+        }
+        keys_.initialize(keys, mode, false, seed);
+        values_.assign(keys_.capacity(), Value());
+        for (const auto& keyAndValue : data) {
+            values_[keys_.find(static_cast<int>(keyAndValue.first))] = keyAndValue.second;
+        }
+    }
+    // returns nullptr if there is no such key
+    const Value* find(Key key) const
+    {
+        long long slot = keys_.find(static_cast<int>(key));
+        if (slot == -1) {
+            return nullptr;
+        }
+        return &values_[slot];
+    }
+    bool contains(Key key) const
+    {
+        return keys_.contains(static_cast<int>(key));
+    }
+
+private:
+    FixedSet keys_;
+    // values_[i] belongs to the key stored in the i-th slot of keys_
+    std::vector<Value> values_;
+};
+
+// Dynamic perfect hashing by Dietzfelbinger et al.: bucket of b elements is a
+// NoCollisionsQuadraticMemoryHashTable reserved for up to 2 * b elements, so an insert
+// rebuilds only its own bucket on a collision or when the bucket doubles, and the top
+// level is rebuilt when the number of elements leaves [limit / 4, limit]. Updates take
+// amortized O(1) time, lookups take worst-case O(1) time.
+class DynamicFixedSet
+{
+public:
+    DynamicFixedSet() : size_(0), limit_(0), totalCapacity_(0), generator_(0) {}
+    void initialize(const std::vector<int>& data, unsigned long long seed = randomSeed())
+    {
+        generator_ = CounterRandomGenerator(seed);
+        rebuild(data);
     }
     bool contains(int element) const
     {
         if (hashTables_.empty()) {
             return false;
         }
+        return hashTables_[hashFunction_(element)].contains(element);
+    }
+    void insert(int element)
+    {
+        if (contains(element)) {
+            return;
+        }
+        ++size_;
+        if (size_ > limit_) {
+            std::vector<int> data = elements();
+            data.push_back(element);
+            rebuild(data);
+            return;
+        }
         long long index = hashFunction_(element);
-        return hashTables_[index].contains(element);
+        ++bucketSizes_[index];
+        if (bucketSizes_[index] <= bucketReservedSizes_[index]) {
+            if (!hashTables_[index].insert(element)) {
+                std::vector<int> bucket = hashTables_[index].elements();
+                bucket.push_back(element);
+                hashTables_[index].initialize(bucket, bucketReservedSizes_[index], generator_);
+            }
+            return;
+        }
+        totalCapacity_ -= hashTables_[index].capacity();
+        bucketReservedSizes_[index] = 2 * bucketSizes_[index];
+        totalCapacity_ += bucketReservedSizes_[index] * bucketReservedSizes_[index];
+        if (totalCapacity_ > maxCapacityPerLimit * limit_) {
+            std::vector<int> data = elements();
+            data.push_back(element);
+            rebuild(data);
+            return;
+        }
+        std::vector<int> bucket = hashTables_[index].elements();
+        bucket.push_back(element);
+        hashTables_[index].initialize(bucket, bucketReservedSizes_[index], generator_);
+    }
+    void erase(int element)
+    {
+        if (!contains(element)) {
+            return;
+        }
+        --size_;
+        long long index = hashFunction_(element);
+        hashTables_[index].erase(element);
+        --bucketSizes_[index];
+        if (size_ < limit_ / 4) {
+            rebuild(elements());
+        }
+    }
+    size_t size() const
+    {
+        return size_;
     }
 
 private:
+    static const size_t minLimit = 4;
+    static const size_t maxCapacityPerLimit = 32;
+
+    std::vector<int> elements() const
+    {
+        std::vector<int> result;
+        for (const auto& hashTable : hashTables_) {
+            std::vector<int> bucket = hashTable.elements();
+            result.insert(result.end(), bucket.begin(), bucket.end());
+        }
+        return result;
+    }
+    void rebuild(const std::vector<int>& data)
+    {
+        size_ = data.size();
+        limit_ = std::max(2 * size_, minLimit);
+        std::vector<std::vector<int>> numbers(limit_);
+        bool stop = false;
+        while (!stop) {
+            hashFunction_ = randomHashFunction(generator_, static_cast<long long>(limit_));
+            for (size_t i = 0; i < numbers.size(); ++i) {
+                numbers[i].resize(0);
+            }
+            for (int element : data) {
+                numbers[hashFunction_(element)].push_back(element);
+            }
+            size_t sumOfSquaresOfLength = 0;
+            for (size_t i = 0; i < numbers.size(); ++i) {
+                sumOfSquaresOfLength += numbers[i].size() * numbers[i].size();
+            }
+            if (sumOfSquaresOfLength < 3 * limit_) {
+                stop = true;
+            }
+        }
+        hashTables_.assign(limit_, NoCollisionsQuadraticMemoryHashTable());
+        bucketSizes_.assign(limit_, 0);
+        bucketReservedSizes_.assign(limit_, 0);
+        totalCapacity_ = 0;
+        for (size_t i = 0; i < limit_; ++i) {
+            bucketSizes_[i] = numbers[i].size();
+            bucketReservedSizes_[i] = 2 * numbers[i].size();
+            hashTables_[i].initialize(numbers[i], bucketReservedSizes_[i], generator_);
+            totalCapacity_ += hashTables_[i].capacity();
+        }
+    }
+
     HashFunction hashFunction_;
     std::vector<NoCollisionsQuadraticMemoryHashTable> hashTables_;
+    std::vector<size_t> bucketSizes_;
+    std::vector<size_t> bucketReservedSizes_;
+    size_t size_;
+    // number of buckets; the top level is rebuilt when size_ exceeds it
+    size_t limit_;
+    // sum of capacities of all buckets
+    size_t totalCapacity_;
+    CounterRandomGenerator generator_;
 };
 
+const size_t DynamicFixedSet::minLimit;
+
 std::vector<int> readNumbers()
 {
     int amountOfNumbers;